@@ -0,0 +1,406 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2017 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmarks gcu-case-converter --stdin on a list of symbols dumped by nm.
+ *
+ * Usage: bench-case-converter [--count N] [--spawns N] [--runs N]
+ *                             gcu-case-converter [binary]
+ *
+ * The symbols are the defined symbols of the binary (an executable or a
+ * library, by default gcu-case-converter itself), as listed by nm. They are
+ * repeated to have --count words, which are converted to each case with one
+ * gcu-case-converter --stdin process. The first --spawns words are also
+ * converted with one process per word, the old way, to check that both give
+ * the same results and to compare the speed.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static gint _count = 1000000;
+static gint _spawns = 200;
+static gint _runs = 3;
+
+static GOptionEntry option_entries[] =
+{
+  { "count", 0, 0, G_OPTION_ARG_INT, &_count,
+    "Number of words converted with --stdin (default: 1000000).", "N" },
+  { "spawns", 0, 0, G_OPTION_ARG_INT, &_spawns,
+    "Number of words converted with one process per word (default: 200).", "N" },
+  { "runs", 0, 0, G_OPTION_ARG_INT, &_runs,
+    "Number of runs with --stdin, the best one is reported (default: 3).", "N" },
+  { NULL }
+};
+
+static const gchar *case_options[] =
+{
+  "--to-uppercase",
+  "--to-camelcase",
+  "--to-lowercase"
+};
+
+static gboolean
+is_identifier (const gchar *str)
+{
+  const gchar *p;
+
+  if (!g_ascii_isalpha (str[0]) && str[0] != '_')
+    return FALSE;
+
+  for (p = str; *p != '\0'; p++)
+    {
+      if (!g_ascii_isalnum (*p) && *p != '_')
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Runs nm, and adds the identifiers to @symbols. The symbol versions
+ * ("@GLIB_2.0") are removed.
+ */
+static void
+add_symbols_from_nm (const gchar *binary,
+                     gboolean     dynamic,
+                     GPtrArray   *symbols)
+{
+  gchar *argv[] = { (gchar *) "nm", (gchar *) "--defined-only", (gchar *) "-P", NULL, NULL, NULL };
+  gchar *nm_output = NULL;
+  gchar **lines;
+  gint exit_status;
+  gint i;
+  GError *error = NULL;
+
+  if (dynamic)
+    {
+      argv[3] = (gchar *) "-D";
+      argv[4] = (gchar *) binary;
+    }
+  else
+    {
+      argv[3] = (gchar *) binary;
+    }
+
+  g_spawn_sync (NULL,
+                argv,
+                NULL,
+                G_SPAWN_SEARCH_PATH | G_SPAWN_STDERR_TO_DEV_NULL,
+                NULL, NULL,
+                &nm_output,
+                NULL,
+                &exit_status,
+                &error);
+  if (error != NULL)
+    g_error ("Impossible to run nm: %s", error->message);
+
+  lines = g_strsplit (nm_output, "\n", -1);
+
+  for (i = 0; lines[i] != NULL; i++)
+    {
+      gchar *name = lines[i];
+      gchar *end = strpbrk (name, " @");
+
+      if (end != NULL)
+        *end = '\0';
+
+      if (is_identifier (name))
+        g_ptr_array_add (symbols, g_strdup (name));
+    }
+
+  g_strfreev (lines);
+  g_free (nm_output);
+}
+
+static GPtrArray *
+get_symbols (const gchar *binary)
+{
+  GPtrArray *symbols = g_ptr_array_new_with_free_func (g_free);
+
+  /* The symbol table, or only the dynamic symbols if the binary is stripped,
+   * like the libraries installed by the distributions.
+   */
+  add_symbols_from_nm (binary, FALSE, symbols);
+  if (symbols->len == 0)
+    add_symbols_from_nm (binary, TRUE, symbols);
+
+  if (symbols->len == 0)
+    g_error ("No symbols found in %s.", binary);
+
+  return symbols;
+}
+
+/* The symbols, repeated to have @count lines. */
+static void
+write_words (const gchar *filename,
+             GPtrArray   *symbols,
+             guint        count)
+{
+  GString *contents;
+  guint i;
+  GError *error = NULL;
+
+  contents = g_string_new (NULL);
+
+  for (i = 0; i < count; i++)
+    {
+      g_string_append (contents, g_ptr_array_index (symbols, i % symbols->len));
+      g_string_append_c (contents, '\n');
+    }
+
+  g_file_set_contents (filename, contents->str, contents->len, &error);
+  if (error != NULL)
+    g_error ("Impossible to write the words: %s", error->message);
+
+  g_string_free (contents, TRUE);
+}
+
+typedef struct
+{
+  gint stdin_fd;
+  gint stdout_fd;
+} Redirections;
+
+/* Called in the child process, after the fork. */
+static void
+redirect_stdin_and_stdout (gpointer user_data)
+{
+  Redirections *redirections = user_data;
+
+  dup2 (redirections->stdin_fd, STDIN_FILENO);
+  dup2 (redirections->stdout_fd, STDOUT_FILENO);
+}
+
+/* Runs gcu-case-converter --stdin, and returns the time in seconds. The
+ * warnings about the contiguous underscores are ignored.
+ */
+static gdouble
+run_stdin_mode (const gchar *program,
+                const gchar *case_option,
+                const gchar *words_filename,
+                const gchar *output_filename)
+{
+  gchar *argv[] = { (gchar *) program, (gchar *) case_option, (gchar *) "--stdin", NULL };
+  Redirections redirections;
+  gint exit_status;
+  gint64 start_time;
+  gdouble seconds;
+  GError *error = NULL;
+
+  redirections.stdin_fd = g_open (words_filename, O_RDONLY, 0);
+  redirections.stdout_fd = g_open (output_filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (redirections.stdin_fd == -1 || redirections.stdout_fd == -1)
+    g_error ("Impossible to open the words or the output: %s", g_strerror (errno));
+
+  start_time = g_get_monotonic_time ();
+
+  g_spawn_sync (NULL,
+                argv,
+                NULL,
+                G_SPAWN_CHILD_INHERITS_STDIN | G_SPAWN_STDERR_TO_DEV_NULL,
+                redirect_stdin_and_stdout,
+                &redirections,
+                NULL,
+                NULL,
+                &exit_status,
+                &error);
+  if (error != NULL)
+    g_error ("Impossible to run %s: %s", program, error->message);
+
+  seconds = (gdouble) (g_get_monotonic_time () - start_time) / G_USEC_PER_SEC;
+
+  /* g_spawn_check_exit_status() is deprecated since GLib 2.70. */
+  if (!WIFEXITED (exit_status) || WEXITSTATUS (exit_status) != 0)
+    g_error ("%s failed.", program);
+
+  close (redirections.stdin_fd);
+  close (redirections.stdout_fd);
+  return seconds;
+}
+
+/* Converts the first @nb_words symbols with one process per word, appends the
+ * results to @output, one per line, and returns the time in seconds.
+ */
+static gdouble
+run_one_process_per_word (const gchar *program,
+                          const gchar *case_option,
+                          GPtrArray   *symbols,
+                          guint        nb_words,
+                          GString     *output)
+{
+  gint64 start_time;
+  guint i;
+
+  start_time = g_get_monotonic_time ();
+
+  for (i = 0; i < nb_words; i++)
+    {
+      gchar *argv[] = { (gchar *) program,
+                        (gchar *) case_option,
+                        g_ptr_array_index (symbols, i % symbols->len),
+                        NULL };
+      gchar *word_output = NULL;
+      gint exit_status;
+      GError *error = NULL;
+
+      g_spawn_sync (NULL,
+                    argv,
+                    NULL,
+                    G_SPAWN_STDERR_TO_DEV_NULL,
+                    NULL, NULL,
+                    &word_output,
+                    NULL,
+                    &exit_status,
+                    &error);
+      if (error != NULL)
+        g_error ("Impossible to run %s: %s", program, error->message);
+
+      g_string_append (output, word_output);
+      g_free (word_output);
+    }
+
+  return (gdouble) (g_get_monotonic_time () - start_time) / G_USEC_PER_SEC;
+}
+
+/* The output of --stdin must start with the output of one process per word. */
+static void
+check_output (const gchar *output_filename,
+              GString     *expected_start,
+              guint        count)
+{
+  gchar *contents;
+  gsize length;
+  gsize pos;
+  guint nb_lines = 0;
+  GError *error = NULL;
+
+  g_file_get_contents (output_filename, &contents, &length, &error);
+  if (error != NULL)
+    g_error ("Impossible to read the output: %s", error->message);
+
+  for (pos = 0; pos < length; pos++)
+    {
+      if (contents[pos] == '\n')
+        nb_lines++;
+    }
+
+  if (nb_lines != count)
+    g_error ("--stdin gives %u lines for %u words.", nb_lines, count);
+
+  if (length < expected_start->len ||
+      memcmp (contents, expected_start->str, expected_start->len) != 0)
+    g_error ("--stdin and one process per word give different results.");
+
+  g_free (contents);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  GOptionContext *option_context;
+  const gchar *program;
+  const gchar *binary;
+  GPtrArray *symbols;
+  gchar *tmp_dir;
+  gchar *words_filename;
+  gchar *output_filename;
+  guint case_num;
+  GError *error = NULL;
+
+  setlocale (LC_ALL, "");
+
+  option_context = g_option_context_new ("gcu-case-converter [binary] - benchmark gcu-case-converter --stdin");
+  g_option_context_add_main_entries (option_context, option_entries, NULL);
+  if (!g_option_context_parse (option_context, &argc, &argv, &error))
+    g_error ("Option parsing failed: %s", error->message);
+  g_option_context_free (option_context);
+
+  if (argc < 2 || argc > 3 || _count < 1 || _spawns < 1 || _spawns > _count || _runs < 1)
+    g_error ("Usage: %s [OPTION...] gcu-case-converter [binary]", argv[0]);
+
+  program = argv[1];
+  binary = argc > 2 ? argv[2] : argv[1];
+
+  symbols = get_symbols (binary);
+
+  tmp_dir = g_dir_make_tmp ("gcu-bench-XXXXXX", &error);
+  if (error != NULL)
+    g_error ("Impossible to create a temporary directory: %s", error->message);
+
+  words_filename = g_build_filename (tmp_dir, "words", NULL);
+  output_filename = g_build_filename (tmp_dir, "output", NULL);
+
+  write_words (words_filename, symbols, _count);
+
+  g_print ("%u symbols from %s, %d words with --stdin (best of %d runs), "
+           "%d words with one process per word.\n",
+           symbols->len, binary, _count, _runs, _spawns);
+  g_print ("%-16s %14s %20s %10s\n", "case", "--stdin", "one process per word", "speedup");
+
+  for (case_num = 0; case_num < G_N_ELEMENTS (case_options); case_num++)
+    {
+      const gchar *case_option = case_options[case_num];
+      GString *expected_start;
+      gdouble best_seconds = 0.0;
+      gdouble spawn_seconds;
+      gdouble stdin_speed;
+      gdouble spawn_speed;
+      gint run;
+
+      for (run = 0; run < _runs; run++)
+        {
+          gdouble seconds = run_stdin_mode (program, case_option, words_filename, output_filename);
+
+          if (run == 0 || seconds < best_seconds)
+            best_seconds = seconds;
+        }
+
+      expected_start = g_string_new (NULL);
+      spawn_seconds = run_one_process_per_word (program, case_option, symbols, _spawns, expected_start);
+      check_output (output_filename, expected_start, _count);
+      g_string_free (expected_start, TRUE);
+
+      stdin_speed = _count / best_seconds;
+      spawn_speed = _spawns / spawn_seconds;
+
+      g_print ("%-16s %8.0f words/s %14.0f words/s %9.0fx\n",
+               case_option,
+               stdin_speed,
+               spawn_speed,
+               stdin_speed / spawn_speed);
+    }
+
+  g_unlink (words_filename);
+  g_unlink (output_filename);
+  g_rmdir (tmp_dir);
+
+  g_free (words_filename);
+  g_free (output_filename);
+  g_free (tmp_dir);
+  g_ptr_array_unref (symbols);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,245 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2013, 2014, 2016, 2017 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Compares gcu_line_scanner_scan() with gcu_line_scanner_scan_with_regex().
+ *
+ * Usage: bench-line-scanner [file...]
+ *
+ * Every line is first checked to give the same results with both
+ * implementations, then both are timed. Without file arguments, a built-in
+ * sample of C code is used, with some corner cases.
+ */
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+#include "gcu-line-scanner.h"
+
+#define MIN_NB_BYTES_SCANNED (64 * 1024 * 1024)
+
+typedef void (*ScanFunc) (const gchar *line,
+                          gsize        length,
+                          GcuLineInfo *info);
+
+static const gchar *sample_lines[] =
+{
+  "/* comment */",
+  "#include <glib.h>",
+  "",
+  "static gboolean",
+  "frobnitz (Frobnitz *frobnitz,",
+  "          gint magic_number,",
+  "          const gchar *const_str,",
+  "          const   gchar  *  name ,  ",
+  "          GError **error)",
+  "{",
+  "  gint i;",
+  "",
+  "  g_return_val_if_fail (FROBNITZ_IS_FROBNITZ (frobnitz), FALSE);",
+  "  for (i = 0; i < magic_number; i++)",
+  "    frobnitz_do_something (frobnitz, i);",
+  "",
+  "  return TRUE;",
+  "}",
+  "",
+  "void",
+  "frobnitz_finalize(GObject *object)",
+  "{ ",
+  "\tG_OBJECT_CLASS (frobnitz_parent_class)->finalize (object);",
+  "}",
+  "foo (const bar,",
+  "     constant baz)",
+  "     const *blah)",
+  "\tunsigned int x,",
+  "\tint\tx)\r",
+  "{\r",
+  "{ x",
+  "foo (int *** x)",
+  " * Un commentaire \xc3\xa0 la fran\xc3\xa7" "aise.",
+  "fonction_\xc3\xa9 (int a,",
+  "          gint \xc3\xb1" "ame,",
+  "          gint name\xc2\xa0)",
+  "\xc3\xa9t\xc3\xa9 (void)",
+  "frobnitz_new (void);",
+  "               GError **error);",
+  "               GError **error) ;",
+  "               GError **error;",
+  "               GError **error,;",
+  "  GtkWidget *widget;",
+  "\tconst gchar*name ;\t",
+  "  guint flag : 1;",
+  "  gchar name[42];",
+  "GtkWidget *widget;",
+  NULL
+};
+
+static GPtrArray *
+get_sample_lines (void)
+{
+  GPtrArray *lines = g_ptr_array_new_with_free_func (g_free);
+  gint i;
+
+  for (i = 0; sample_lines[i] != NULL; i++)
+    g_ptr_array_add (lines, g_strdup (sample_lines[i]));
+
+  return lines;
+}
+
+static GPtrArray *
+get_file_lines (gchar **filenames)
+{
+  GPtrArray *lines = g_ptr_array_new_with_free_func (g_free);
+  gint file_num;
+
+  for (file_num = 0; filenames[file_num] != NULL; file_num++)
+    {
+      gchar *contents;
+      gchar **file_lines;
+      gint i;
+      GError *error = NULL;
+
+      g_file_get_contents (filenames[file_num], &contents, NULL, &error);
+      if (error != NULL)
+        g_error ("Impossible to get file contents: %s", error->message);
+
+      file_lines = g_strsplit (contents, "\n", 0);
+      for (i = 0; file_lines[i] != NULL; i++)
+        g_ptr_array_add (lines, file_lines[i]);
+
+      /* The strings are now owned by @lines. */
+      g_free (file_lines);
+      g_free (contents);
+    }
+
+  return lines;
+}
+
+static gboolean
+check_lines (GPtrArray *lines)
+{
+  gboolean ok = TRUE;
+  guint i;
+
+  for (i = 0; i < lines->len; i++)
+    {
+      const gchar *line = g_ptr_array_index (lines, i);
+      GcuLineInfo scanner_info;
+      GcuLineInfo regex_info;
+
+      gcu_line_scanner_scan (line, strlen (line), &scanner_info);
+      gcu_line_scanner_scan_with_regex (line, strlen (line), &regex_info);
+
+      if (memcmp (&scanner_info, &regex_info, sizeof (GcuLineInfo)) != 0)
+        {
+          g_printerr ("Different results for line: \"%s\"\n", line);
+          ok = FALSE;
+        }
+    }
+
+  return ok;
+}
+
+static gdouble
+time_scan_func (ScanFunc   scan_func,
+                GPtrArray *lines,
+                guint      nb_iterations)
+{
+  GcuLineInfo info;
+  gint64 start_time;
+  guint iteration;
+
+  start_time = g_get_monotonic_time ();
+
+  for (iteration = 0; iteration < nb_iterations; iteration++)
+    {
+      guint i;
+
+      for (i = 0; i < lines->len; i++)
+        {
+          const gchar *line = g_ptr_array_index (lines, i);
+          scan_func (line, strlen (line), &info);
+        }
+    }
+
+  return (gdouble) (g_get_monotonic_time () - start_time) / G_USEC_PER_SEC;
+}
+
+static void
+print_result (const gchar *name,
+              gdouble      seconds,
+              gsize        nb_bytes,
+              guint        nb_lines)
+{
+  g_print ("%-8s %8.3f s  %10.1f MB/s  %8.1f ns/line\n",
+           name,
+           seconds,
+           nb_bytes / seconds / (1024 * 1024),
+           seconds * 1e9 / nb_lines);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  GPtrArray *lines;
+  gsize nb_bytes_per_iteration = 0;
+  guint nb_iterations;
+  gdouble scanner_time;
+  gdouble regex_time;
+  guint i;
+
+  setlocale (LC_ALL, "");
+
+  if (argc > 1)
+    lines = get_file_lines (argv + 1);
+  else
+    lines = get_sample_lines ();
+
+  for (i = 0; i < lines->len; i++)
+    nb_bytes_per_iteration += strlen (g_ptr_array_index (lines, i)) + 1;
+
+  if (!check_lines (lines))
+    {
+      g_ptr_array_unref (lines);
+      return EXIT_FAILURE;
+    }
+
+  nb_iterations = MAX (1, MIN_NB_BYTES_SCANNED / MAX (1, nb_bytes_per_iteration));
+
+  g_print ("%u lines, %u iterations, %.1f MB scanned.\n",
+           lines->len,
+           nb_iterations,
+           (gdouble) nb_bytes_per_iteration * nb_iterations / (1024 * 1024));
+
+  scanner_time = time_scan_func (gcu_line_scanner_scan, lines, nb_iterations);
+  regex_time = time_scan_func (gcu_line_scanner_scan_with_regex, lines, nb_iterations);
+
+  print_result ("scanner", scanner_time,
+                nb_bytes_per_iteration * nb_iterations,
+                lines->len * nb_iterations);
+  print_result ("GRegex", regex_time,
+                nb_bytes_per_iteration * nb_iterations,
+                lines->len * nb_iterations);
+  g_print ("Speedup: %.1fx\n", regex_time / scanner_time);
+
+  g_ptr_array_unref (lines);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,747 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2013, 2014, 2016, 2017 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmarks gcu-lineup-parameters on generated C code.
+ *
+ * Usage: bench-lineup-parameters [--sizes MiB,...] [--mix M:A:O] [--seed N]
+ *                                [--runs N] [--output FILE]
+ *                                gcu-lineup-parameters [malloc-counter.so]
+ *
+ * A corpus of each size (from 1 MiB to 1 GiB) is generated, always the same
+ * for a given seed. It is a mix of blocks: function declarations to align,
+ * already aligned function declarations, and other code that doesn't match
+ * (comments, function calls, macros, functions without parameters, ...). The
+ * mix gives the relative weights of the three kinds of blocks.
+ *
+ * gcu-lineup-parameters is then run on the corpus, with a file argument
+ * (the file is rewritten), on stdin, and with --check --all. For each mode
+ * the best of the runs is reported: MiB/s, peak RSS and, if the
+ * malloc-counter module is given, the number of memory allocations.
+ *
+ * With --output, the corpus of the first size is only written to FILE.
+ */
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define MAX_SIZE_MIB 1024
+#define FLUSH_SIZE (1024 * 1024)
+
+typedef enum
+{
+  BLOCK_MISALIGNED,
+  BLOCK_ALIGNED,
+  BLOCK_OTHER,
+  NB_BLOCK_KINDS
+} BlockKind;
+
+typedef enum
+{
+  MODE_FILE,
+  MODE_STDIN,
+  MODE_CHECK,
+  NB_MODES
+} Mode;
+
+typedef struct
+{
+  gdouble seconds;
+  glong max_rss_kib;
+
+  /* -1 if unknown. */
+  gint64 nb_allocations;
+} RunResult;
+
+static gchar *_sizes = NULL;
+static gchar *_mix = NULL;
+static gint _seed = 1;
+static gint _runs = 3;
+static gchar *_output = NULL;
+
+static GOptionEntry option_entries[] =
+{
+  { "sizes", 0, 0, G_OPTION_ARG_STRING, &_sizes,
+    "Comma-separated sizes of the corpus, in mebibytes (default: 1,16,64).", "MiB,..." },
+  { "mix", 0, 0, G_OPTION_ARG_STRING, &_mix,
+    "Relative weights of the blocks to align, already aligned and not matching "
+    "(default: 30:20:50).", "M:A:O" },
+  { "seed", 0, 0, G_OPTION_ARG_INT, &_seed,
+    "Seed of the corpus generator (default: 1).", "N" },
+  { "runs", 0, 0, G_OPTION_ARG_INT, &_runs,
+    "Number of runs of each mode, the best one is reported (default: 3).", "N" },
+  { "output", 'o', 0, G_OPTION_ARG_FILENAME, &_output,
+    "Only write the corpus of the first size to FILE.", "FILE" },
+  { NULL }
+};
+
+static const gchar *mode_names[NB_MODES] =
+{
+  "file",
+  "stdin",
+  "check"
+};
+
+static const gchar *types[] =
+{
+  "gint",
+  "guint",
+  "gchar",
+  "const gchar",
+  "gboolean",
+  "gdouble",
+  "gpointer",
+  "GError",
+  "GObject",
+  "GList",
+  "GtkWidget",
+  "GtkTextBuffer",
+  "Frobnitz",
+  "FrobnitzPrivate",
+  "const GtkTextIter"
+};
+
+static const gchar *return_types[] =
+{
+  "void",
+  "gboolean",
+  "gint",
+  "static void",
+  "static gboolean",
+  "GtkWidget *",
+  "const gchar *",
+  "Frobnitz *"
+};
+
+static const gchar *words[] =
+{
+  "frobnitz",
+  "buffer",
+  "widget",
+  "name",
+  "error",
+  "magic",
+  "number",
+  "iter",
+  "data",
+  "length",
+  "position",
+  "flags",
+  "style",
+  "scheme",
+  "child",
+  "get",
+  "set",
+  "new"
+};
+
+static const gchar *other_lines[] =
+{
+  "#include <glib.h>\n",
+  "#include \"frobnitz.h\"\n",
+  "\n",
+  "/* A comment. */\n",
+  "static gint counter = 0;\n",
+  "G_DEFINE_TYPE (Frobnitz, frobnitz, G_TYPE_OBJECT)\n",
+  "G_DEFINE_TYPE_WITH_PRIVATE (FrobnitzChild, frobnitz_child, FROBNITZ_TYPE_FROBNITZ)\n",
+  "enum\n{\n  PROP_0,\n  PROP_NAME,\n  N_PROPERTIES\n};\n",
+  "static GParamSpec *properties[N_PROPERTIES];\n",
+  "#define FROBNITZ_MAGIC_NUMBER (42)\n"
+};
+
+static const gchar *statements[] =
+{
+  "  g_return_if_fail (FROBNITZ_IS_FROBNITZ (frobnitz));\n",
+  "  frobnitz_do_something (frobnitz, magic_number);\n",
+  "  if (error != NULL)\n    return;\n",
+  "  for (i = 0; i < length; i++)\n    g_print (\"%d\\n\", i);\n",
+  "  g_object_notify_by_pspec (G_OBJECT (frobnitz), properties[PROP_NAME]);\n",
+  "  /* Do something (or not). */\n",
+  "\n"
+};
+
+/* One or more words joined by "_". */
+static void
+append_identifier (GString *out,
+                   GRand   *rand,
+                   guint    max_nb_words)
+{
+  guint nb_words = g_rand_int_range (rand, 1, max_nb_words + 1);
+  guint i;
+
+  for (i = 0; i < nb_words; i++)
+    {
+      if (i > 0)
+        g_string_append_c (out, '_');
+
+      g_string_append (out, words[g_rand_int_range (rand, 0, G_N_ELEMENTS (words))]);
+    }
+}
+
+static void
+append_random_line (GString      *out,
+                    GRand        *rand,
+                    const gchar **lines,
+                    guint         nb_lines)
+{
+  g_string_append (out, lines[g_rand_int_range (rand, 0, nb_lines)]);
+}
+
+static void
+append_body (GString *out,
+             GRand   *rand)
+{
+  guint nb_statements = g_rand_int_range (rand, 1, 8);
+  guint i;
+
+  g_string_append (out, "{\n");
+
+  for (i = 0; i < nb_statements; i++)
+    append_random_line (out, rand, statements, G_N_ELEMENTS (statements));
+
+  g_string_append (out, "}\n\n");
+}
+
+/* A function definition, or sometimes a prototype, with one parameter per
+ * line. If @aligned, the parameters are aligned like gcu-lineup-parameters
+ * does.
+ */
+static void
+append_function_declaration (GString  *out,
+                             GRand    *rand,
+                             gboolean  aligned)
+{
+  const gchar *param_types[8];
+  guint param_stars[8];
+  GString *param_names[8];
+  guint nb_params = g_rand_int_range (rand, 1, G_N_ELEMENTS (param_types) + 1);
+  gboolean is_prototype = g_rand_int_range (rand, 0, 4) == 0;
+  gsize max_type_length = 0;
+  guint max_stars = 0;
+  gsize name_line_start;
+  gsize indentation;
+  guint i;
+
+  for (i = 0; i < nb_params; i++)
+    {
+      param_types[i] = types[g_rand_int_range (rand, 0, G_N_ELEMENTS (types))];
+      param_stars[i] = g_rand_int_range (rand, 0, 3);
+      param_names[i] = g_string_new (NULL);
+      append_identifier (param_names[i], rand, 2);
+
+      max_type_length = MAX (max_type_length, strlen (param_types[i]));
+      max_stars = MAX (max_stars, param_stars[i]);
+    }
+
+  append_random_line (out, rand, return_types, G_N_ELEMENTS (return_types));
+  g_string_append_c (out, '\n');
+
+  name_line_start = out->len;
+  g_string_append (out, "frobnitz_");
+  append_identifier (out, rand, 3);
+  g_string_append (out, " (");
+  indentation = out->len - name_line_start;
+
+  for (i = 0; i < nb_params; i++)
+    {
+      guint nb_spaces = 1;
+
+      if (i > 0)
+        {
+          g_string_append_c (out, '\n');
+          g_string_append_printf (out, "%*s", (gint) indentation, "");
+        }
+
+      g_string_append (out, param_types[i]);
+
+      if (aligned)
+        nb_spaces += (max_type_length - strlen (param_types[i])) + (max_stars - param_stars[i]);
+
+      g_string_append_printf (out, "%*s%.*s%s",
+                              (gint) nb_spaces, "",
+                              (gint) param_stars[i], "**",
+                              param_names[i]->str);
+
+      g_string_append_c (out, i < nb_params - 1 ? ',' : ')');
+      g_string_free (param_names[i], TRUE);
+    }
+
+  if (is_prototype)
+    {
+      g_string_append (out, ";\n\n");
+      return;
+    }
+
+  g_string_append_c (out, '\n');
+  append_body (out, rand);
+}
+
+/* Code that doesn't match, but some lines look like the start of a function
+ * declaration.
+ */
+static void
+append_other_block (GString *out,
+                    GRand   *rand)
+{
+  switch (g_rand_int_range (rand, 0, 3))
+    {
+    case 0:
+      /* A function without parameters. */
+      g_string_append (out, "static void\nfrobnitz_");
+      append_identifier (out, rand, 3);
+      g_string_append (out, " (void)\n");
+      append_body (out, rand);
+      break;
+
+    case 1:
+      g_string_append (out,
+                       "/*\n"
+                       " * frobnitz_do_something:\n"
+                       " * @frobnitz: a #Frobnitz.\n"
+                       " *\n"
+                       " * Returns: (transfer full): something.\n"
+                       " */\n");
+      break;
+
+    default:
+      append_random_line (out, rand, other_lines, G_N_ELEMENTS (other_lines));
+      break;
+    }
+}
+
+static BlockKind
+get_random_block_kind (GRand       *rand,
+                       const guint *mix)
+{
+  guint total = mix[BLOCK_MISALIGNED] + mix[BLOCK_ALIGNED] + mix[BLOCK_OTHER];
+  guint n = g_rand_int_range (rand, 0, total);
+
+  if (n < mix[BLOCK_MISALIGNED])
+    return BLOCK_MISALIGNED;
+
+  if (n < mix[BLOCK_MISALIGNED] + mix[BLOCK_ALIGNED])
+    return BLOCK_ALIGNED;
+
+  return BLOCK_OTHER;
+}
+
+/* Writes @size bytes or a bit more of generated C code to @filename. */
+static void
+generate_corpus (const gchar *filename,
+                 gsize        size,
+                 const guint *mix)
+{
+  GFile *file;
+  GFileOutputStream *stream;
+  GRand *rand;
+  GString *out;
+  gsize nb_bytes_written = 0;
+  GError *error = NULL;
+
+  file = g_file_new_for_path (filename);
+  stream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, &error);
+  if (error != NULL)
+    g_error ("Impossible to write the corpus: %s", error->message);
+
+  rand = g_rand_new_with_seed (_seed);
+  out = g_string_sized_new (FLUSH_SIZE + 4096);
+
+  while (nb_bytes_written < size)
+    {
+      switch (get_random_block_kind (rand, mix))
+        {
+        case BLOCK_MISALIGNED:
+          append_function_declaration (out, rand, FALSE);
+          break;
+
+        case BLOCK_ALIGNED:
+          append_function_declaration (out, rand, TRUE);
+          break;
+
+        case BLOCK_OTHER:
+        case NB_BLOCK_KINDS:
+        default:
+          append_other_block (out, rand);
+          break;
+        }
+
+      if (out->len >= FLUSH_SIZE || nb_bytes_written + out->len >= size)
+        {
+          g_output_stream_write_all (G_OUTPUT_STREAM (stream), out->str, out->len, NULL, NULL, &error);
+          if (error != NULL)
+            g_error ("Impossible to write the corpus: %s", error->message);
+
+          nb_bytes_written += out->len;
+          g_string_truncate (out, 0);
+        }
+    }
+
+  g_output_stream_close (G_OUTPUT_STREAM (stream), NULL, &error);
+  if (error != NULL)
+    g_error ("Impossible to write the corpus: %s", error->message);
+
+  g_string_free (out, TRUE);
+  g_rand_free (rand);
+  g_object_unref (stream);
+  g_object_unref (file);
+}
+
+static void
+copy_file (const gchar *source_filename,
+           const gchar *dest_filename)
+{
+  GFile *source;
+  GFile *dest;
+  GError *error = NULL;
+
+  source = g_file_new_for_path (source_filename);
+  dest = g_file_new_for_path (dest_filename);
+
+  g_file_copy (source, dest, G_FILE_COPY_OVERWRITE, NULL, NULL, NULL, &error);
+  if (error != NULL)
+    g_error ("Impossible to copy the corpus: %s", error->message);
+
+  g_object_unref (source);
+  g_object_unref (dest);
+}
+
+/* Called in the child process, after the fork. */
+static void
+redirect_stdin (gpointer user_data)
+{
+  gint fd = GPOINTER_TO_INT (user_data);
+
+  if (fd != -1)
+    dup2 (fd, STDIN_FILENO);
+}
+
+static gint64
+read_nb_allocations (const gchar *filename)
+{
+  gchar *contents;
+  gint64 nb_allocations;
+
+  if (!g_file_get_contents (filename, &contents, NULL, NULL))
+    return -1;
+
+  nb_allocations = g_ascii_strtoll (contents, NULL, 10);
+  g_free (contents);
+  return nb_allocations;
+}
+
+/* Runs gcu-lineup-parameters once. @stdin_filename can be NULL. */
+static RunResult
+run_program (gchar       **argv,
+             const gchar  *stdin_filename,
+             const gchar  *malloc_counter,
+             const gchar  *counter_output,
+             gboolean      check_mode)
+{
+  RunResult result;
+  gchar **envp;
+  gint stdin_fd = -1;
+  GPid pid;
+  gint status;
+  struct rusage usage;
+  gint64 start_time;
+  GError *error = NULL;
+
+  envp = g_get_environ ();
+  if (malloc_counter != NULL)
+    {
+      envp = g_environ_setenv (envp, "LD_PRELOAD", malloc_counter, TRUE);
+      envp = g_environ_setenv (envp, "GCU_MALLOC_COUNTER_OUTPUT", counter_output, TRUE);
+      g_unlink (counter_output);
+    }
+
+  if (stdin_filename != NULL)
+    {
+      stdin_fd = g_open (stdin_filename, O_RDONLY, 0);
+      if (stdin_fd == -1)
+        g_error ("Impossible to open the corpus: %s", g_strerror (errno));
+    }
+
+  start_time = g_get_monotonic_time ();
+
+  g_spawn_async (NULL,
+                 argv,
+                 envp,
+                 G_SPAWN_DO_NOT_REAP_CHILD |
+                 G_SPAWN_CHILD_INHERITS_STDIN |
+                 G_SPAWN_STDOUT_TO_DEV_NULL |
+                 G_SPAWN_STDERR_TO_DEV_NULL,
+                 redirect_stdin,
+                 GINT_TO_POINTER (stdin_fd),
+                 &pid,
+                 &error);
+  if (error != NULL)
+    g_error ("Impossible to run %s: %s", argv[0], error->message);
+
+  /* wait4() gives the resource usage of this child only. */
+  if (wait4 (pid, &status, 0, &usage) == -1)
+    g_error ("wait4() failed: %s", g_strerror (errno));
+
+  result.seconds = (gdouble) (g_get_monotonic_time () - start_time) / G_USEC_PER_SEC;
+  result.max_rss_kib = usage.ru_maxrss;
+  result.nb_allocations = malloc_counter != NULL ? read_nb_allocations (counter_output) : -1;
+
+  /* The summary and the --check report, on stderr, are discarded. With
+   * --check, the exit status is 1 if there are misaligned function
+   * declarations.
+   */
+  if (!WIFEXITED (status) ||
+      (WEXITSTATUS (status) != 0 && !check_mode))
+    g_error ("%s failed.", argv[0]);
+
+  if (stdin_fd != -1)
+    close (stdin_fd);
+  g_spawn_close_pid (pid);
+  g_strfreev (envp);
+  return result;
+}
+
+static RunResult
+run_mode (Mode         mode,
+          const gchar *program,
+          const gchar *corpus_filename,
+          const gchar *work_filename,
+          const gchar *malloc_counter,
+          const gchar *counter_output)
+{
+  RunResult best = { 0 };
+  gint run;
+
+  for (run = 0; run < _runs; run++)
+    {
+      gchar *argv[5] = { (gchar *) program, NULL };
+      const gchar *stdin_filename = NULL;
+      RunResult result;
+
+      switch (mode)
+        {
+        case MODE_FILE:
+          /* The file is rewritten, so each run needs a fresh copy. */
+          copy_file (corpus_filename, work_filename);
+          argv[1] = (gchar *) work_filename;
+          break;
+
+        case MODE_STDIN:
+          stdin_filename = corpus_filename;
+          break;
+
+        case MODE_CHECK:
+          argv[1] = (gchar *) "--check";
+          argv[2] = (gchar *) "--all";
+          argv[3] = (gchar *) corpus_filename;
+          break;
+
+        case NB_MODES:
+        default:
+          g_assert_not_reached ();
+        }
+
+      result = run_program (argv, stdin_filename, malloc_counter, counter_output, mode == MODE_CHECK);
+
+      if (run == 0 || result.seconds < best.seconds)
+        best = result;
+    }
+
+  return best;
+}
+
+static void
+print_result (Mode       mode,
+              gsize      size,
+              RunResult *result)
+{
+  gchar *nb_allocations;
+
+  if (result->nb_allocations >= 0)
+    nb_allocations = g_strdup_printf ("%" G_GINT64_FORMAT, result->nb_allocations);
+  else
+    nb_allocations = g_strdup ("n/a");
+
+  g_print ("%-6s %7.1f MiB %8.3f s %10.1f MiB/s %9.1f MiB %12s\n",
+           mode_names[mode],
+           (gdouble) size / (1024 * 1024),
+           result->seconds,
+           size / result->seconds / (1024 * 1024),
+           result->max_rss_kib / 1024.0,
+           nb_allocations);
+
+  g_free (nb_allocations);
+}
+
+static gboolean
+parse_sizes (const gchar *str,
+             GArray      *sizes)
+{
+  gchar **parts;
+  gboolean ok = TRUE;
+  gint i;
+
+  parts = g_strsplit (str, ",", -1);
+
+  for (i = 0; parts[i] != NULL; i++)
+    {
+      gchar *end;
+      guint64 size_mib = g_ascii_strtoull (parts[i], &end, 10);
+      gsize size;
+
+      if (end == parts[i] || *end != '\0' ||
+          size_mib < 1 || size_mib > MAX_SIZE_MIB)
+        {
+          ok = FALSE;
+          break;
+        }
+
+      size = size_mib * 1024 * 1024;
+      g_array_append_val (sizes, size);
+    }
+
+  g_strfreev (parts);
+  return ok && sizes->len > 0;
+}
+
+static gboolean
+parse_mix (const gchar *str,
+           guint       *mix)
+{
+  gchar **parts;
+  gboolean ok;
+  gint i;
+
+  parts = g_strsplit (str, ":", -1);
+  ok = g_strv_length (parts) == NB_BLOCK_KINDS;
+
+  for (i = 0; ok && i < NB_BLOCK_KINDS; i++)
+    {
+      gchar *end;
+      guint64 weight = g_ascii_strtoull (parts[i], &end, 10);
+
+      ok = end != parts[i] && *end == '\0' && weight <= 1000;
+      mix[i] = weight;
+    }
+
+  g_strfreev (parts);
+  return ok && mix[BLOCK_MISALIGNED] + mix[BLOCK_ALIGNED] + mix[BLOCK_OTHER] > 0;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  GOptionContext *option_context;
+  GArray *sizes;
+  guint mix[NB_BLOCK_KINDS];
+  const gchar *program;
+  const gchar *malloc_counter;
+  gchar *tmp_dir;
+  gchar *corpus_filename;
+  gchar *work_filename;
+  gchar *counter_output;
+  guint i;
+  GError *error = NULL;
+
+  setlocale (LC_ALL, "");
+
+  option_context = g_option_context_new ("gcu-lineup-parameters [malloc-counter.so] - benchmark gcu-lineup-parameters");
+  g_option_context_add_main_entries (option_context, option_entries, NULL);
+  if (!g_option_context_parse (option_context, &argc, &argv, &error))
+    g_error ("Option parsing failed: %s", error->message);
+  g_option_context_free (option_context);
+
+  sizes = g_array_new (FALSE, FALSE, sizeof (gsize));
+
+  if (!parse_sizes (_sizes != NULL ? _sizes : "1,16,64", sizes))
+    g_error ("Invalid sizes, they must be between 1 and %d MiB.", MAX_SIZE_MIB);
+
+  if (!parse_mix (_mix != NULL ? _mix : "30:20:50", mix))
+    g_error ("Invalid mix.");
+
+  if (_output != NULL)
+    {
+      generate_corpus (_output, g_array_index (sizes, gsize, 0), mix);
+      return EXIT_SUCCESS;
+    }
+
+  if (argc < 2 || argc > 3 || _runs < 1)
+    g_error ("Usage: %s [OPTION...] gcu-lineup-parameters [malloc-counter.so]", argv[0]);
+
+  program = argv[1];
+  malloc_counter = argc > 2 ? argv[2] : NULL;
+
+  tmp_dir = g_dir_make_tmp ("gcu-bench-XXXXXX", &error);
+  if (error != NULL)
+    g_error ("Impossible to create a temporary directory: %s", error->message);
+
+  corpus_filename = g_build_filename (tmp_dir, "corpus.c", NULL);
+  work_filename = g_build_filename (tmp_dir, "work.c", NULL);
+  counter_output = g_build_filename (tmp_dir, "nb-allocations", NULL);
+
+  g_print ("Seed %d, mix %u:%u:%u (to align:aligned:other), best of %d runs.\n",
+           _seed, mix[BLOCK_MISALIGNED], mix[BLOCK_ALIGNED], mix[BLOCK_OTHER], _runs);
+  g_print ("%-6s %11s %10s %15s %13s %12s\n",
+           "mode", "size", "time", "speed", "peak RSS", "allocations");
+
+  for (i = 0; i < sizes->len; i++)
+    {
+      gsize size = g_array_index (sizes, gsize, i);
+      struct stat corpus_stat;
+      Mode mode;
+
+      generate_corpus (corpus_filename, size, mix);
+
+      /* The generator writes a bit more than asked. */
+      if (g_stat (corpus_filename, &corpus_stat) == 0)
+        size = corpus_stat.st_size;
+
+      for (mode = 0; mode < NB_MODES; mode++)
+        {
+          RunResult result;
+
+          result = run_mode (mode, program, corpus_filename, work_filename,
+                             malloc_counter, counter_output);
+          print_result (mode, size, &result);
+        }
+    }
+
+  g_unlink (corpus_filename);
+  g_unlink (work_filename);
+  g_unlink (counter_output);
+  g_rmdir (tmp_dir);
+
+  g_free (corpus_filename);
+  g_free (work_filename);
+  g_free (counter_output);
+  g_free (tmp_dir);
+  g_array_free (sizes, TRUE);
+  g_free (_sizes);
+  g_free (_mix);
+  g_free (_output);
+  return EXIT_SUCCESS;
+}
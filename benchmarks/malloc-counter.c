@@ -0,0 +1,87 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2013, 2014, 2016, 2017 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Counts the calls to malloc(), calloc() and realloc() of a program, for
+ * bench-lineup-parameters. To be loaded with LD_PRELOAD. At exit, the count
+ * is written to the file named by the GCU_MALLOC_COUNTER_OUTPUT environment
+ * variable.
+ *
+ * Only for the GNU libc, the real functions are called with their __libc_*
+ * names, and GLib is not used since it allocates memory too.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+/* The program can have several threads. */
+static unsigned long nb_allocations;
+
+static void
+count_allocation (void)
+{
+  __atomic_add_fetch (&nb_allocations, 1, __ATOMIC_RELAXED);
+}
+
+void *
+malloc (size_t size)
+{
+  count_allocation ();
+  return __libc_malloc (size);
+}
+
+void *
+calloc (size_t nmemb,
+        size_t size)
+{
+  count_allocation ();
+  return __libc_calloc (nmemb, size);
+}
+
+void *
+realloc (void   *ptr,
+         size_t  size)
+{
+  count_allocation ();
+  return __libc_realloc (ptr, size);
+}
+
+__attribute__ ((destructor))
+static void
+write_nb_allocations (void)
+{
+  const char *filename;
+  FILE *file;
+
+  filename = getenv ("GCU_MALLOC_COUNTER_OUTPUT");
+  if (filename == NULL)
+    return;
+
+  file = fopen (filename, "w");
+  if (file == NULL)
+    return;
+
+  fprintf (file, "%lu\n", __atomic_load_n (&nb_allocations, __ATOMIC_RELAXED));
+  fclose (file);
+}
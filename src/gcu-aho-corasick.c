@@ -0,0 +1,394 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2017 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Searches several literal patterns at once, with the Aho-Corasick algorithm.
+ * The text is scanned once, byte per byte, whatever the number of patterns.
+ *
+ * The patterns are first added to a trie. Before the first search, the trie
+ * is turned into a full automaton: each state has a transition for each of
+ * the 256 byte values, so the scan does one table lookup per byte, without
+ * following the failure links. The memory used is 1 KiB per state, that is
+ * per byte of the patterns, it is fine for a list of renames.
+ *
+ * The search is case sensitive and works on bytes. With UTF-8 patterns and
+ * text, a match always starts and ends on character boundaries.
+ *
+ * The matches returned don't overlap: at each position the leftmost match is
+ * taken, and the longest one if several patterns start there. It is what a
+ * sequence of forward searches would give with a single pattern.
+ *
+ * With GCU_AHO_CORASICK_FLAGS_WHOLE_IDENTIFIERS, the matches that start or end
+ * in the middle of an identifier are discarded during the scan, so they don't
+ * hide another match. The bytes of an identifier are the ASCII letters and
+ * digits, '_' and the non-ASCII bytes, since GCC accepts UTF-8 in identifiers.
+ * It is like \b in a regex, but a match can also start or end with a
+ * non-identifier character, without constraint on that side.
+ */
+
+#include "gcu-aho-corasick.h"
+
+#define NO_PATTERN G_MAXUINT
+
+#define ROOT_STATE (0)
+
+typedef struct
+{
+  /* The id of the pattern ending at this state, or NO_PATTERN. */
+  guint pattern_id;
+
+  /* The next state on the chain of failure links that ends a pattern, or
+   * ROOT_STATE if there is none (the empty pattern is not allowed).
+   */
+  guint output_link;
+} State;
+
+struct _GcuAhoCorasick
+{
+  /* Lengths of the patterns, the index is the pattern id. */
+  GArray *pattern_lengths;
+
+  GArray *states;
+
+  /* 256 transitions per state. In the trie, ROOT_STATE means no transition,
+   * since no transition goes back to the root.
+   */
+  GArray *transitions;
+
+  guint built : 1;
+};
+
+GcuAhoCorasick *
+gcu_aho_corasick_new (void)
+{
+  GcuAhoCorasick *ac;
+  State root = { NO_PATTERN, ROOT_STATE };
+
+  ac = g_new0 (GcuAhoCorasick, 1);
+  ac->pattern_lengths = g_array_new (FALSE, FALSE, sizeof (gsize));
+  ac->states = g_array_new (FALSE, FALSE, sizeof (State));
+  ac->transitions = g_array_new (FALSE, TRUE, sizeof (guint));
+
+  g_array_append_val (ac->states, root);
+  g_array_set_size (ac->transitions, 256);
+
+  return ac;
+}
+
+void
+gcu_aho_corasick_free (GcuAhoCorasick *ac)
+{
+  if (ac != NULL)
+    {
+      g_array_unref (ac->pattern_lengths);
+      g_array_unref (ac->states);
+      g_array_unref (ac->transitions);
+      g_free (ac);
+    }
+}
+
+static inline guint *
+get_transitions (GcuAhoCorasick *ac,
+                 guint           state)
+{
+  return &g_array_index (ac->transitions, guint, state * 256);
+}
+
+static inline State *
+get_state (GcuAhoCorasick *ac,
+           guint           state)
+{
+  return &g_array_index (ac->states, State, state);
+}
+
+/* Returns the id of the pattern, the number of patterns added before. If the
+ * same pattern was already added, its id is returned instead and nothing is
+ * added.
+ */
+guint
+gcu_aho_corasick_add_pattern (GcuAhoCorasick *ac,
+                              const gchar    *pattern,
+                              gsize           length)
+{
+  guint state = ROOT_STATE;
+  gsize pos;
+
+  g_return_val_if_fail (ac != NULL, NO_PATTERN);
+  g_return_val_if_fail (pattern != NULL, NO_PATTERN);
+  g_return_val_if_fail (length > 0, NO_PATTERN);
+  g_return_val_if_fail (!ac->built, NO_PATTERN);
+
+  for (pos = 0; pos < length; pos++)
+    {
+      guchar c = pattern[pos];
+      guint next_state = get_transitions (ac, state)[c];
+
+      if (next_state == ROOT_STATE)
+        {
+          State new_state = { NO_PATTERN, ROOT_STATE };
+
+          next_state = ac->states->len;
+          g_array_append_val (ac->states, new_state);
+          g_array_set_size (ac->transitions, ac->transitions->len + 256);
+
+          get_transitions (ac, state)[c] = next_state;
+        }
+
+      state = next_state;
+    }
+
+  if (get_state (ac, state)->pattern_id == NO_PATTERN)
+    {
+      get_state (ac, state)->pattern_id = ac->pattern_lengths->len;
+      g_array_append_val (ac->pattern_lengths, length);
+    }
+
+  return get_state (ac, state)->pattern_id;
+}
+
+guint
+gcu_aho_corasick_get_n_patterns (GcuAhoCorasick *ac)
+{
+  g_return_val_if_fail (ac != NULL, 0);
+
+  return ac->pattern_lengths->len;
+}
+
+/* Breadth-first traversal of the trie, so the failure link of a state,
+ * which is shorter, is complete when the state is reached.
+ */
+static void
+build_automaton (GcuAhoCorasick *ac)
+{
+  GArray *queue;
+  guint *fail_links;
+  guint queue_pos;
+  guint c;
+
+  fail_links = g_new0 (guint, ac->states->len);
+  queue = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  for (c = 0; c < 256; c++)
+    {
+      guint child = get_transitions (ac, ROOT_STATE)[c];
+
+      if (child != ROOT_STATE)
+        g_array_append_val (queue, child);
+    }
+
+  for (queue_pos = 0; queue_pos < queue->len; queue_pos++)
+    {
+      guint state = g_array_index (queue, guint, queue_pos);
+      guint *transitions = get_transitions (ac, state);
+      guint *fail_transitions = get_transitions (ac, fail_links[state]);
+
+      for (c = 0; c < 256; c++)
+        {
+          guint child = transitions[c];
+          guint child_fail;
+
+          if (child == ROOT_STATE)
+            {
+              transitions[c] = fail_transitions[c];
+              continue;
+            }
+
+          child_fail = fail_transitions[c];
+          fail_links[child] = child_fail;
+
+          if (get_state (ac, child_fail)->pattern_id != NO_PATTERN)
+            get_state (ac, child)->output_link = child_fail;
+          else
+            get_state (ac, child)->output_link = get_state (ac, child_fail)->output_link;
+
+          g_array_append_val (queue, child);
+        }
+    }
+
+  g_array_unref (queue);
+  g_free (fail_links);
+
+  ac->built = TRUE;
+}
+
+static inline gboolean
+is_identifier_byte (gchar c)
+{
+  return g_ascii_isalnum (c) || c == '_' || (guchar) c >= 0x80;
+}
+
+/* Whether [@start, @end) cuts an identifier of @text. */
+static inline gboolean
+cuts_identifier (const gchar *text,
+                 gsize        length,
+                 gsize        start,
+                 gsize        end)
+{
+  if (start > 0 &&
+      is_identifier_byte (text[start - 1]) &&
+      is_identifier_byte (text[start]))
+    return TRUE;
+
+  if (end < length &&
+      is_identifier_byte (text[end - 1]) &&
+      is_identifier_byte (text[end]))
+    return TRUE;
+
+  return FALSE;
+}
+
+static gint
+compare_matches (gconstpointer a,
+                 gconstpointer b)
+{
+  const GcuAhoCorasickMatch *match_a = a;
+  const GcuAhoCorasickMatch *match_b = b;
+
+  if (match_a->start != match_b->start)
+    return match_a->start < match_b->start ? -1 : 1;
+
+  /* The longest first. */
+  if (match_a->end != match_b->end)
+    return match_a->end > match_b->end ? -1 : 1;
+
+  return 0;
+}
+
+static void
+add_match (GcuAhoCorasick      *ac,
+           GArray              *matches,
+           guint                pattern_id,
+           const gchar         *text,
+           gsize                length,
+           gsize                end,
+           GcuAhoCorasickFlags  flags)
+{
+  GcuAhoCorasickMatch match;
+
+  match.start = end - g_array_index (ac->pattern_lengths, gsize, pattern_id);
+  match.end = end;
+  match.pattern_id = pattern_id;
+
+  if ((flags & GCU_AHO_CORASICK_FLAGS_WHOLE_IDENTIFIERS) != 0 &&
+      cuts_identifier (text, length, match.start, match.end))
+    return;
+
+  g_array_append_val (matches, match);
+}
+
+/* Returns the non-overlapping matches, sorted by position. Free the array
+ * with g_array_unref().
+ */
+GArray *
+gcu_aho_corasick_find_all (GcuAhoCorasick      *ac,
+                           const gchar         *text,
+                           gsize                length,
+                           GcuAhoCorasickFlags  flags)
+{
+  GArray *matches;
+  GArray *selected_matches;
+  guint state = ROOT_STATE;
+  gsize pos;
+  gsize selected_end = 0;
+  guint i;
+
+  g_return_val_if_fail (ac != NULL, NULL);
+  g_return_val_if_fail (text != NULL || length == 0, NULL);
+
+  if (!ac->built)
+    build_automaton (ac);
+
+  matches = g_array_new (FALSE, FALSE, sizeof (GcuAhoCorasickMatch));
+
+  /* All the matches, even overlapping, in the order of their end. */
+  for (pos = 0; pos < length; pos++)
+    {
+      guint output_state;
+
+      state = get_transitions (ac, state)[(guchar) text[pos]];
+      if (state == ROOT_STATE)
+        continue;
+
+      if (get_state (ac, state)->pattern_id != NO_PATTERN)
+        add_match (ac, matches,
+                   get_state (ac, state)->pattern_id,
+                   text, length, pos + 1, flags);
+
+      for (output_state = get_state (ac, state)->output_link;
+           output_state != ROOT_STATE;
+           output_state = get_state (ac, output_state)->output_link)
+        {
+          add_match (ac, matches,
+                     get_state (ac, output_state)->pattern_id,
+                     text, length, pos + 1, flags);
+        }
+    }
+
+  g_array_sort (matches, compare_matches);
+
+  selected_matches = g_array_new (FALSE, FALSE, sizeof (GcuAhoCorasickMatch));
+
+  for (i = 0; i < matches->len; i++)
+    {
+      GcuAhoCorasickMatch *match = &g_array_index (matches, GcuAhoCorasickMatch, i);
+
+      if (match->start >= selected_end)
+        {
+          g_array_append_val (selected_matches, *match);
+          selected_end = match->end;
+        }
+    }
+
+  g_array_unref (matches);
+  return selected_matches;
+}
+
+/* Returns whether at least one pattern occurs in @text, which is scanned until
+ * the first match. The matches are not restricted to whole identifiers.
+ */
+gboolean
+gcu_aho_corasick_contains_any (GcuAhoCorasick *ac,
+                               const gchar    *text,
+                               gsize           length)
+{
+  guint state = ROOT_STATE;
+  gsize pos;
+
+  g_return_val_if_fail (ac != NULL, FALSE);
+  g_return_val_if_fail (text != NULL || length == 0, FALSE);
+
+  if (!ac->built)
+    build_automaton (ac);
+
+  for (pos = 0; pos < length; pos++)
+    {
+      const State *state_data;
+
+      state = get_transitions (ac, state)[(guchar) text[pos]];
+      if (state == ROOT_STATE)
+        continue;
+
+      state_data = get_state (ac, state);
+      if (state_data->pattern_id != NO_PATTERN ||
+          state_data->output_link != ROOT_STATE)
+        return TRUE;
+    }
+
+  return FALSE;
+}
@@ -0,0 +1,70 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2017 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GCU_AHO_CORASICK_H
+#define GCU_AHO_CORASICK_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GcuAhoCorasick GcuAhoCorasick;
+
+typedef enum
+{
+  GCU_AHO_CORASICK_FLAGS_NONE = 0,
+
+  /* A match must cover whole C identifiers: it can't start or end in the
+   * middle of an identifier.
+   */
+  GCU_AHO_CORASICK_FLAGS_WHOLE_IDENTIFIERS = 1 << 0
+} GcuAhoCorasickFlags;
+
+/* A match of a pattern, @start and @end are byte offsets in the text, @end
+ * being exclusive.
+ */
+typedef struct
+{
+  gsize start;
+  gsize end;
+  guint pattern_id;
+} GcuAhoCorasickMatch;
+
+GcuAhoCorasick *        gcu_aho_corasick_new            (void);
+
+void                    gcu_aho_corasick_free           (GcuAhoCorasick *ac);
+
+guint                   gcu_aho_corasick_add_pattern    (GcuAhoCorasick *ac,
+                                                         const gchar    *pattern,
+                                                         gsize           length);
+
+guint                   gcu_aho_corasick_get_n_patterns (GcuAhoCorasick *ac);
+
+GArray *                gcu_aho_corasick_find_all       (GcuAhoCorasick      *ac,
+                                                         const gchar         *text,
+                                                         gsize                length,
+                                                         GcuAhoCorasickFlags  flags);
+
+gboolean                gcu_aho_corasick_contains_any   (GcuAhoCorasick *ac,
+                                                         const gchar    *text,
+                                                         gsize           length);
+
+G_END_DECLS
+
+#endif /* GCU_AHO_CORASICK_H */
@@ -32,6 +32,92 @@
  * only one function call must be given to stdin.
  */
 
+/*
+ * Server mode:
+ *
+ * Launching a process for each alignment adds a noticeable delay in a text
+ * editor. With --server, the program stays alive and answers requests one after
+ * the other, until the end of the input.
+ *
+ * A request is the length in bytes of the text, in decimal, followed by a
+ * newline, followed by the text itself (what would be given to stdin without
+ * --server). The response has the same format, with the aligned text.
+ *
+ * The response to an invalid request is a line starting with "ERROR ", followed
+ * by the error message, without text. If the length of the text could be read
+ * in the header, the text is skipped, and the server continues with the next
+ * request. The server stops with an error only if the input is truncated or
+ * can not be read.
+ *
+ * The requests are read from stdin and the responses are written to stdout. With
+ * --socket=PATH, the program instead listens on a Unix socket, several clients
+ * can be connected at the same time and each connection can send several
+ * requests. A stale socket file at PATH is removed first.
+ *
+ * For example:
+ * $ printf '14\nfoo (a,\n  b);\n' | gcu-align-params-on-parenthesis --server
+ * 17
+ * foo (a,
+ *      b);
+ *
+ * Batch requests:
+ *
+ * To align several regions of a file in one round trip (for example with
+ * several cursors), the whole file is sent and the length in the header is
+ * followed by the regions, as byte offsets START:END in the text, END excluded.
+ * Each region is extended to whole lines, and is aligned like a selection given
+ * without --server, the first line containing the opening parenthesis. The
+ * regions can be given in any order. Regions that overlap once extended, for
+ * example several cursors on the same line, are merged into one region.
+ * Regions that only touch, on consecutive lines, are aligned independently.
+ *
+ * The response of a batch request contains only the edits: the length in the
+ * header is followed by START:END:LENGTH for each region that has changed,
+ * sorted by START, and the text is the concatenation of the replacements. The
+ * offsets refer to the text of the request, so the edits must be applied from
+ * the last one to the first one. No edits at all is "0\n".
+ *
+ * For example, to align the two function calls of a file:
+ * 28 0:14 14:28
+ * foo (a,
+ *   b);
+ * bar (c,
+ *   d);
+ *
+ * The response:
+ * 34 0:14:17 14:28:17
+ * foo (a,
+ *      b);
+ * bar (c,
+ *      d);
+ */
+
+/*
+ * Whole-file mode:
+ *
+ * With --whole-file, all the multi-line argument lists of C files are aligned
+ * in one pass, without selecting them. A line is aligned when it starts inside
+ * parentheses, and when the innermost opening parenthesis is followed by some
+ * text on its own line, for example:
+ *
+ * function_call (param1,
+ *    param2);
+ *
+ * The line is aligned on the text following the parenthesis, a comment or the
+ * \r of a CRLF line ending are not text to align on. The parentheses are
+ * matched, so nested calls work, and the string literals, comments and
+ * preprocessor directives are skipped. The tabs are expanded to find the
+ * columns, with a tab width of 8, and a realigned line keeps an indentation
+ * with tabs if it had tabs. The lines starting inside brackets or curly braces,
+ * or with a closing parenthesis, are not modified. A curly brace at the start
+ * of a line (a function body) resets the parentheses, in case they don't match
+ * because of #if branches.
+ *
+ * The files given as arguments or with --files-from are modified in place, in
+ * the same process. Without files, stdin is read and the result is written to
+ * stdout.
+ */
+
 /*
  * Use with Vim:
  *
@@ -59,9 +145,77 @@
 
 #include <gio/gio.h>
 #include <gio/gunixinputstream.h>
+#include <gio/gunixoutputstream.h>
+#include <gio/gunixsocketaddress.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <locale.h>
 
+/* Bigger requests are refused by the server, to not allocate any size read
+ * from a client.
+ */
+#define MAX_REQUEST_LENGTH (256 * 1024 * 1024)
+
+/* A region of a batch request, in bytes, @end excluded. */
+typedef struct
+{
+  gsize start;
+  gsize end;
+} ByteRange;
+
+/* For --whole-file. */
+#define TAB_WIDTH 8
+
+typedef enum
+{
+  LEX_STATE_CODE,
+  LEX_STATE_STRING,
+  LEX_STATE_CHAR,
+  LEX_STATE_BLOCK_COMMENT,
+  LEX_STATE_LINE_COMMENT
+} LexState;
+
+/* An opening parenthesis, bracket or curly brace, for --whole-file. */
+typedef struct
+{
+  gchar c;
+
+  /* Where the text of the continuation lines must start: the column of the
+   * text following @c on its line.
+   */
+  guint column;
+
+  guint line_num;
+
+  /* Whether some text follows @c on its line. */
+  guint has_text_after : 1;
+} OpenDelimiter;
+
+static gboolean _server;
+static gchar *_socket_path;
+static gboolean _whole_file;
+static gchar *_files_from;
+
+static gint _nb_errors;
+static gint _nb_modified_files;
+static gint _nb_unmodified_files;
+
+static GOptionEntry option_entries[] =
+{
+  { "server", 0, 0, G_OPTION_ARG_NONE, &_server,
+    "Stay alive and answer length-prefixed requests, read from stdin.", NULL },
+  { "socket", 0, 0, G_OPTION_ARG_FILENAME, &_socket_path,
+    "With --server, read the requests from a Unix socket instead of stdin.", "PATH" },
+  { "whole-file", 0, 0, G_OPTION_ARG_NONE, &_whole_file,
+    "Align all the multi-line argument lists of the files, modified in place "
+    "(or of stdin, without files).", NULL },
+  { "files-from", 0, 0, G_OPTION_ARG_FILENAME, &_files_from,
+    "With --whole-file, read NUL-separated filenames from FILE (\"-\" for stdin).", "FILE" },
+  { NULL }
+};
+
 /* Returns on which column the text of the following lines must be placed. */
 static gint
 get_column_num (const gchar *first_line)
@@ -87,9 +241,14 @@ get_indentation (gint column_num)
   return g_strnfill (column_num, ' ');
 }
 
+/* @has_newline is FALSE for the last line of a text without a final
+ * newline.
+ */
 static void
-print_following_line (const gchar *line,
-                      const gchar *indentation)
+append_following_line (GString     *output,
+                       const gchar *line,
+                       const gchar *indentation,
+                       gboolean     has_newline)
 {
   const gchar *line_text;
 
@@ -105,11 +264,16 @@ print_following_line (const gchar *line,
   while (*line_text != '\0' && g_ascii_isspace (*line_text))
     line_text++;
 
-  g_print ("%s%s\n", indentation, line_text);
+  g_string_append (output, indentation);
+  g_string_append (output, line_text);
+
+  if (has_newline)
+    g_string_append_c (output, '\n');
 }
 
 static void
-align_params_on_parenthesis (const gchar *input_str)
+align_params_on_parenthesis (const gchar *input_str,
+                             GString     *output)
 {
   gchar **lines;
   gint column_num;
@@ -123,17 +287,19 @@ align_params_on_parenthesis (const gchar *input_str)
   column_num = get_column_num (lines[0]);
   if (column_num == -1)
     {
-      /* Opening parenthesis not founnd, print the input unmodified. */
-      g_print ("%s", input_str);
+      /* Opening parenthesis not founnd, return the input unmodified. */
+      g_string_append (output, input_str);
       goto out;
     }
 
   indentation = get_indentation (column_num);
 
-  g_print ("%s\n", lines[0]);
+  g_string_append (output, lines[0]);
+  if (lines[1] != NULL)
+    g_string_append_c (output, '\n');
 
   for (i = 1; lines[i] != NULL; i++)
-    print_following_line (lines[i], indentation);
+    append_following_line (output, lines[i], indentation, lines[i + 1] != NULL);
 
 out:
   g_strfreev (lines);
@@ -141,7 +307,7 @@ out:
 }
 
 static gchar *
-get_stdin_contents (void)
+get_stdin_contents (gsize *length)
 {
   GInputStream *stream;
   GString *string;
@@ -161,24 +327,954 @@ get_stdin_contents (void)
       if (error != NULL)
         g_error ("Impossible to read stdin: %s", error->message);
 
-      g_string_append (string, buffer);
+      g_string_append_len (string, buffer, nb_bytes_read);
     }
 
   g_input_stream_close (stream, NULL, NULL);
   g_object_unref (stream);
 
+  *length = string->len;
   return g_string_free (string, FALSE);
 }
 
+/* Parses a byte offset at *str, and advances *str after it. */
+static gboolean
+parse_offset (const gchar **str,
+              gsize        *offset)
+{
+  gchar *end;
+  guint64 value;
+
+  if (!g_ascii_isdigit (**str))
+    return FALSE;
+
+  value = g_ascii_strtoull (*str, &end, 10);
+  if (value > MAX_REQUEST_LENGTH)
+    return FALSE;
+
+  *offset = value;
+  *str = end;
+  return TRUE;
+}
+
+/* Parses the header of a request: the length of the text, and the regions for a
+ * batch request. *has_text_length is set to TRUE as soon as the length of the
+ * text is known, even if the rest of the header is invalid, so that the text
+ * can be skipped.
+ */
+static gboolean
+parse_request_header (const gchar  *header,
+                      gsize        *text_length,
+                      gboolean     *has_text_length,
+                      GArray       *regions,
+                      GError      **error)
+{
+  const gchar *str = header;
+  gchar *end;
+  guint64 value;
+
+  *has_text_length = FALSE;
+
+  if (!g_ascii_isdigit (*str))
+    goto invalid;
+
+  value = g_ascii_strtoull (str, &end, 10);
+  if (value > G_MAXSIZE)
+    goto invalid;
+
+  *text_length = value;
+  *has_text_length = TRUE;
+  str = end;
+
+  if (value > MAX_REQUEST_LENGTH)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVALID_DATA,
+                   "Request too big: %" G_GSIZE_FORMAT " bytes.",
+                   *text_length);
+      return FALSE;
+    }
+
+  while (*str == ' ')
+    {
+      ByteRange region;
+
+      str++;
+
+      if (!parse_offset (&str, &region.start) ||
+          *str != ':')
+        goto invalid;
+
+      str++;
+
+      if (!parse_offset (&str, &region.end) ||
+          region.start > region.end ||
+          region.end > *text_length)
+        goto invalid;
+
+      g_array_append_val (regions, region);
+    }
+
+  if (*str != '\0')
+    goto invalid;
+
+  return TRUE;
+
+invalid:
+  g_set_error (error,
+               G_IO_ERROR,
+               G_IO_ERROR_INVALID_DATA,
+               "Invalid request header: \"%s\".",
+               header);
+  return FALSE;
+}
+
+static void
+set_truncated_request_error (GError **error,
+                             gsize    text_length,
+                             gsize    nb_bytes_read)
+{
+  g_set_error (error,
+               G_IO_ERROR,
+               G_IO_ERROR_PARTIAL_INPUT,
+               "Truncated request: %" G_GSIZE_FORMAT " bytes announced, "
+               "%" G_GSIZE_FORMAT " bytes received.",
+               text_length,
+               nb_bytes_read);
+}
+
+/* Skips the text of an invalid request, without allocating it. */
+static gboolean
+skip_request_text (GInputStream  *input,
+                   gsize          text_length,
+                   GError       **error)
+{
+  gsize nb_bytes_skipped = 0;
+
+  while (nb_bytes_skipped < text_length)
+    {
+      gssize n;
+
+      n = g_input_stream_skip (input,
+                               MIN (text_length - nb_bytes_skipped, 65536),
+                               NULL,
+                               error);
+      if (n < 0)
+        return FALSE;
+
+      if (n == 0)
+        {
+          set_truncated_request_error (error, text_length, nb_bytes_skipped);
+          return FALSE;
+        }
+
+      nb_bytes_skipped += n;
+    }
+
+  return TRUE;
+}
+
+/* Extends @region to whole lines. An empty region is the line containing it. */
+static void
+extend_region_to_lines (const gchar *text,
+                        gsize        text_length,
+                        ByteRange   *region)
+{
+  while (region->start > 0 && text[region->start - 1] != '\n')
+    region->start--;
+
+  if (region->end > region->start && text[region->end - 1] == '\n')
+    return;
+
+  while (region->end < text_length && text[region->end] != '\n')
+    region->end++;
+
+  if (region->end < text_length)
+    region->end++;
+}
+
+static gint
+compare_regions (gconstpointer a,
+                 gconstpointer b)
+{
+  const ByteRange *region_a = a;
+  const ByteRange *region_b = b;
+
+  if (region_a->start < region_b->start)
+    return -1;
+  if (region_a->start > region_b->start)
+    return 1;
+  return 0;
+}
+
+/* Extends the regions to whole lines, sorts them, and merges the regions that
+ * overlap. The regions that only touch are kept separate, they are aligned
+ * independently.
+ */
+static void
+prepare_regions (const gchar *text,
+                 gsize        text_length,
+                 GArray      *regions)
+{
+  guint nb_merged_regions = 0;
+  guint i;
+
+  for (i = 0; i < regions->len; i++)
+    extend_region_to_lines (text, text_length, &g_array_index (regions, ByteRange, i));
+
+  g_array_sort (regions, compare_regions);
+
+  for (i = 0; i < regions->len; i++)
+    {
+      const ByteRange *region = &g_array_index (regions, ByteRange, i);
+      ByteRange *previous = NULL;
+
+      if (nb_merged_regions > 0)
+        previous = &g_array_index (regions, ByteRange, nb_merged_regions - 1);
+
+      if (previous != NULL && region->start < previous->end)
+        {
+          previous->end = MAX (previous->end, region->end);
+          continue;
+        }
+
+      g_array_index (regions, ByteRange, nb_merged_regions) = *region;
+      nb_merged_regions++;
+    }
+
+  g_array_set_size (regions, nb_merged_regions);
+}
+
+/* Appends the replacements of the regions that change to @response, and their
+ * START:END:LENGTH to @edits.
+ */
+static void
+align_regions (const gchar *text,
+               GArray      *regions,
+               GString     *edits,
+               GString     *response)
+{
+  guint i;
+
+  for (i = 0; i < regions->len; i++)
+    {
+      const ByteRange *region = &g_array_index (regions, ByteRange, i);
+      gsize region_length = region->end - region->start;
+      gsize replacement_pos = response->len;
+      gsize replacement_length;
+      gchar *region_text;
+
+      region_text = g_strndup (text + region->start, region_length);
+      align_params_on_parenthesis (region_text, response);
+      g_free (region_text);
+
+      replacement_length = response->len - replacement_pos;
+
+      if (replacement_length == region_length &&
+          memcmp (response->str + replacement_pos, text + region->start, region_length) == 0)
+        {
+          g_string_truncate (response, replacement_pos);
+          continue;
+        }
+
+      g_string_append_printf (edits,
+                              " %" G_GSIZE_FORMAT ":%" G_GSIZE_FORMAT ":%" G_GSIZE_FORMAT,
+                              region->start,
+                              region->end,
+                              replacement_length);
+    }
+}
+
+static gboolean
+write_response (GOutputStream  *output,
+                const gchar    *edits,
+                GString        *response,
+                GError        **error)
+{
+  gchar *header;
+  gboolean ok;
+
+  /* Only one write per response. */
+  header = g_strdup_printf ("%" G_GSIZE_FORMAT "%s\n", response->len, edits);
+  g_string_prepend (response, header);
+  g_free (header);
+
+  ok = (g_output_stream_write_all (output, response->str, response->len, NULL, NULL, error) &&
+        g_output_stream_flush (output, NULL, error));
+
+  return ok;
+}
+
+static gboolean
+write_error_response (GOutputStream  *output,
+                      const gchar    *message,
+                      GError        **error)
+{
+  gchar *response;
+  gboolean ok;
+
+  response = g_strdup_printf ("ERROR %s\n", message);
+
+  ok = (g_output_stream_write_all (output, response, strlen (response), NULL, NULL, error) &&
+        g_output_stream_flush (output, NULL, error));
+
+  g_free (response);
+  return ok;
+}
+
+/* Answers the requests of @input until the end of @input. An invalid request
+ * gets an error response, and the next request is served. Returns FALSE only
+ * for I/O errors and truncated requests, after which the stream can not be
+ * read further.
+ */
+static gboolean
+serve_requests (GInputStream   *input,
+                GOutputStream  *output,
+                GError        **error)
+{
+  GDataInputStream *data_input;
+  GArray *regions;
+  GString *edits;
+  GString *response;
+  gboolean ok = TRUE;
+
+  data_input = g_data_input_stream_new (input);
+  g_data_input_stream_set_newline_type (data_input, G_DATA_STREAM_NEWLINE_TYPE_LF);
+  g_filter_input_stream_set_close_base_stream (G_FILTER_INPUT_STREAM (data_input), FALSE);
+
+  regions = g_array_new (FALSE, FALSE, sizeof (ByteRange));
+  edits = g_string_new (NULL);
+  response = g_string_new (NULL);
+
+  while (TRUE)
+    {
+      gchar *header;
+      gchar *text;
+      gsize text_length = 0;
+      gboolean has_text_length;
+      gsize nb_bytes_read = 0;
+      GError *request_error = NULL;
+
+      header = g_data_input_stream_read_line (data_input, NULL, NULL, &request_error);
+      if (header == NULL)
+        {
+          /* NULL without error at the end of the input. */
+          if (request_error != NULL)
+            {
+              g_propagate_error (error, request_error);
+              ok = FALSE;
+            }
+
+          break;
+        }
+
+      g_array_set_size (regions, 0);
+
+      if (!parse_request_header (header, &text_length, &has_text_length, regions, &request_error))
+        {
+          g_free (header);
+
+          /* Without the length, the header line alone is skipped. */
+          ok = ((!has_text_length ||
+                 skip_request_text (G_INPUT_STREAM (data_input), text_length, error)) &&
+                write_error_response (output, request_error->message, error));
+
+          g_error_free (request_error);
+
+          if (!ok)
+            break;
+
+          continue;
+        }
+
+      g_free (header);
+
+      text = g_malloc (text_length + 1);
+
+      if (!g_input_stream_read_all (G_INPUT_STREAM (data_input),
+                                    text, text_length,
+                                    &nb_bytes_read,
+                                    NULL, error))
+        {
+          g_free (text);
+          ok = FALSE;
+          break;
+        }
+
+      if (nb_bytes_read != text_length)
+        {
+          set_truncated_request_error (&request_error, text_length, nb_bytes_read);
+
+          /* The client may still be reading. */
+          write_error_response (output, request_error->message, NULL);
+
+          g_propagate_error (error, request_error);
+          g_free (text);
+          ok = FALSE;
+          break;
+        }
+
+      text[text_length] = '\0';
+
+      g_string_truncate (edits, 0);
+      g_string_truncate (response, 0);
+
+      if (regions->len == 0)
+        {
+          align_params_on_parenthesis (text, response);
+        }
+      else
+        {
+          prepare_regions (text, text_length, regions);
+          align_regions (text, regions, edits, response);
+        }
+
+      g_free (text);
+
+      if (!write_response (output, edits->str, response, error))
+        {
+          ok = FALSE;
+          break;
+        }
+    }
+
+  g_array_free (regions, TRUE);
+  g_string_free (edits, TRUE);
+  g_string_free (response, TRUE);
+  g_object_unref (data_input);
+  return ok;
+}
+
+static gboolean
+serve_stdin (void)
+{
+  GInputStream *input;
+  GOutputStream *output;
+  GError *error = NULL;
+  gboolean ok;
+
+  input = g_unix_input_stream_new (STDIN_FILENO, FALSE);
+  output = g_unix_output_stream_new (STDOUT_FILENO, FALSE);
+
+  ok = serve_requests (input, output, &error);
+  if (!ok)
+    {
+      g_printerr ("Server error: %s\n", error->message);
+      g_error_free (error);
+    }
+
+  g_object_unref (input);
+  g_object_unref (output);
+  return ok;
+}
+
+static gpointer
+serve_connection_thread (gpointer data)
+{
+  GSocketConnection *connection = data;
+  GError *error = NULL;
+
+  if (!serve_requests (g_io_stream_get_input_stream (G_IO_STREAM (connection)),
+                       g_io_stream_get_output_stream (G_IO_STREAM (connection)),
+                       &error))
+    {
+      g_printerr ("Connection error: %s\n", error->message);
+      g_error_free (error);
+    }
+
+  g_object_unref (connection);
+  return NULL;
+}
+
+static void
+remove_stale_socket (const gchar *path)
+{
+  GStatBuf stat_buf;
+
+  if (g_lstat (path, &stat_buf) == 0 &&
+      S_ISSOCK (stat_buf.st_mode))
+    g_unlink (path);
+}
+
+/* Each connection is served in its own thread, so that a client keeping its
+ * connection open doesn't block the others.
+ */
+static void
+serve_socket (const gchar *path)
+{
+  GSocketListener *listener;
+  GSocketAddress *address;
+  GError *error = NULL;
+
+  remove_stale_socket (path);
+
+  listener = g_socket_listener_new ();
+  address = g_unix_socket_address_new (path);
+
+  if (!g_socket_listener_add_address (listener,
+                                      address,
+                                      G_SOCKET_TYPE_STREAM,
+                                      G_SOCKET_PROTOCOL_DEFAULT,
+                                      NULL,
+                                      NULL,
+                                      &error))
+    g_error ("Impossible to listen on \"%s\": %s", path, error->message);
+
+  g_object_unref (address);
+
+  while (TRUE)
+    {
+      GSocketConnection *connection;
+
+      connection = g_socket_listener_accept (listener, NULL, NULL, &error);
+      if (connection == NULL)
+        g_error ("Impossible to accept a connection: %s", error->message);
+
+      g_thread_unref (g_thread_new ("connection", serve_connection_thread, connection));
+    }
+}
+
+static guint
+advance_column (guint column,
+                gchar c)
+{
+  if (c == '\t')
+    return (column / TAB_WIDTH + 1) * TAB_WIDTH;
+
+  /* A UTF-8 continuation byte is part of the previous character. */
+  if (((guchar) c & 0xC0) == 0x80)
+    return column;
+
+  return column + 1;
+}
+
+/* With @use_tabs, as many tabs as possible followed by spaces. */
+static void
+append_indentation (GString  *output,
+                    guint     column,
+                    gboolean  use_tabs)
+{
+  guint i;
+
+  if (use_tabs)
+    {
+      for (i = 0; i < column / TAB_WIDTH; i++)
+        g_string_append_c (output, '\t');
+
+      column %= TAB_WIDTH;
+    }
+
+  for (i = 0; i < column; i++)
+    g_string_append_c (output, ' ');
+}
+
+/* Returns the innermost OpenDelimiter, or NULL. */
+static OpenDelimiter *
+get_innermost_delimiter (GArray *stack)
+{
+  if (stack->len == 0)
+    return NULL;
+
+  return &g_array_index (stack, OpenDelimiter, stack->len - 1);
+}
+
+/* For a line starting inside parentheses, returns the column where its text must
+ * start, or -1 if the line must not be modified.
+ */
+static gint
+get_continuation_column (GArray *stack,
+                         gchar   first_char)
+{
+  const OpenDelimiter *innermost = get_innermost_delimiter (stack);
+
+  if (innermost == NULL ||
+      innermost->c != '(' ||
+      !innermost->has_text_after)
+    return -1;
+
+  /* Empty line, or closing parenthesis. */
+  if (first_char == '\n' ||
+      first_char == '\r' ||
+      first_char == ')')
+    return -1;
+
+  return innermost->column;
+}
+
+/* One linear pass on @contents. The unmodified parts are copied to @output in
+ * runs, only the indentation of the misaligned lines is replaced.
+ */
+static void
+align_whole_file (const gchar *contents,
+                  gsize        length,
+                  GString     *output)
+{
+  GArray *stack;
+  LexState state = LEX_STATE_CODE;
+  gboolean in_directive = FALSE;
+  guint line_num = 0;
+  gsize copy_start = 0;
+  gsize pos = 0;
+
+  stack = g_array_new (FALSE, FALSE, sizeof (OpenDelimiter));
+
+  while (pos < length)
+    {
+      gsize text_pos = pos;
+      guint column = 0;
+
+      /* Indentation. */
+      while (text_pos < length &&
+             (contents[text_pos] == ' ' || contents[text_pos] == '\t'))
+        {
+          column = advance_column (column, contents[text_pos]);
+          text_pos++;
+        }
+
+      if (state == LEX_STATE_CODE &&
+          !in_directive &&
+          text_pos < length)
+        {
+          gchar first_char = contents[text_pos];
+          gint continuation_column;
+
+          if (first_char == '#')
+            {
+              in_directive = TRUE;
+            }
+          else if ((first_char == '{' || first_char == '}') &&
+                   text_pos == pos)
+            {
+              g_array_set_size (stack, 0);
+            }
+          else if ((continuation_column = get_continuation_column (stack, first_char)) != -1 &&
+                   (guint) continuation_column != column)
+            {
+              gboolean use_tabs = memchr (contents + pos, '\t', text_pos - pos) != NULL;
+
+              g_string_append_len (output, contents + copy_start, pos - copy_start);
+              append_indentation (output, continuation_column, use_tabs);
+              column = continuation_column;
+              copy_start = text_pos;
+            }
+        }
+
+      /* Rest of the line. */
+      for (pos = text_pos; pos < length && contents[pos] != '\n'; pos++)
+        {
+          gchar c = contents[pos];
+          gchar next_char = pos + 1 < length ? contents[pos + 1] : '\0';
+          OpenDelimiter *innermost;
+
+          switch (state)
+            {
+            case LEX_STATE_CODE:
+              /* The comments and the \r of CRLF line endings are not text to
+               * align on.
+               */
+              innermost = get_innermost_delimiter (stack);
+              if (innermost != NULL &&
+                  innermost->line_num == line_num &&
+                  !innermost->has_text_after &&
+                  c != ' ' && c != '\t' &&
+                  !(c == '\r' && (next_char == '\n' || next_char == '\0')) &&
+                  !(c == '/' && (next_char == '*' || next_char == '/')))
+                {
+                  innermost->has_text_after = TRUE;
+                  innermost->column = column;
+                }
+
+              if (c == '/' && next_char == '*')
+                {
+                  state = LEX_STATE_BLOCK_COMMENT;
+                  column = advance_column (column, c);
+                  pos++;
+                  c = next_char;
+                }
+              else if (c == '/' && next_char == '/')
+                {
+                  state = LEX_STATE_LINE_COMMENT;
+                }
+              else if (c == '"')
+                {
+                  state = LEX_STATE_STRING;
+                }
+              else if (c == '\'')
+                {
+                  state = LEX_STATE_CHAR;
+                }
+              else if (in_directive)
+                {
+                  /* The delimiters of the directives are ignored. */
+                }
+              else if (c == '(' || c == '[' || c == '{')
+                {
+                  OpenDelimiter delimiter;
+
+                  delimiter.c = c;
+                  delimiter.column = 0;
+                  delimiter.line_num = line_num;
+                  delimiter.has_text_after = FALSE;
+                  g_array_append_val (stack, delimiter);
+                }
+              else if ((c == ')' || c == ']' || c == '}') &&
+                       stack->len > 0)
+                {
+                  g_array_set_size (stack, stack->len - 1);
+                }
+              break;
+
+            case LEX_STATE_STRING:
+            case LEX_STATE_CHAR:
+              if (c == '\\' && next_char != '\n' && next_char != '\0')
+                {
+                  column = advance_column (column, c);
+                  pos++;
+                  c = next_char;
+                }
+              else if ((c == '"' && state == LEX_STATE_STRING) ||
+                       (c == '\'' && state == LEX_STATE_CHAR))
+                {
+                  state = LEX_STATE_CODE;
+                }
+              break;
+
+            case LEX_STATE_BLOCK_COMMENT:
+              if (c == '*' && next_char == '/')
+                {
+                  state = LEX_STATE_CODE;
+                  column = advance_column (column, c);
+                  pos++;
+                  c = next_char;
+                }
+              break;
+
+            case LEX_STATE_LINE_COMMENT:
+              break;
+
+            default:
+              g_assert_not_reached ();
+            }
+
+          column = advance_column (column, c);
+        }
+
+      /* End of line. */
+      if (pos < length)
+        {
+          gboolean escaped = pos > 0 && contents[pos - 1] == '\\';
+
+          if (!escaped)
+            {
+              in_directive = FALSE;
+
+              /* An unterminated literal is a syntax error, don't let it run
+               * until the end of the file.
+               */
+              if (state != LEX_STATE_BLOCK_COMMENT)
+                state = LEX_STATE_CODE;
+            }
+
+          pos++;
+          line_num++;
+        }
+    }
+
+  g_string_append_len (output, contents + copy_start, length - copy_start);
+  g_array_free (stack, TRUE);
+}
+
+static gboolean
+handle_file (const gchar  *filename,
+             GError      **error)
+{
+  GFile *file;
+  gchar *contents = NULL;
+  gsize length;
+  GString *output = NULL;
+  gboolean ok = FALSE;
+
+  file = g_file_new_for_commandline_arg (filename);
+
+  if (!g_file_load_contents (file, NULL, &contents, &length, NULL, error))
+    goto out;
+
+  output = g_string_sized_new (length);
+  align_whole_file (contents, length, output);
+
+  if (output->len == length &&
+      memcmp (output->str, contents, length) == 0)
+    {
+      _nb_unmodified_files++;
+      ok = TRUE;
+      goto out;
+    }
+
+  ok = g_file_replace_contents (file,
+                                output->str,
+                                output->len,
+                                NULL,
+                                FALSE,
+                                G_FILE_CREATE_NONE,
+                                NULL,
+                                NULL,
+                                error);
+
+  if (ok)
+    _nb_modified_files++;
+
+out:
+  g_object_unref (file);
+  g_free (contents);
+  if (output != NULL)
+    g_string_free (output, TRUE);
+  return ok;
+}
+
+static void
+handle_files (GPtrArray *filenames)
+{
+  guint i;
+
+  for (i = 0; i < filenames->len; i++)
+    {
+      const gchar *filename = g_ptr_array_index (filenames, i);
+      GError *error = NULL;
+
+      if (!handle_file (filename, &error))
+        {
+          g_printerr ("%s: %s\n", filename, error->message);
+          g_error_free (error);
+          _nb_errors++;
+        }
+    }
+
+  g_printerr ("Modified files: %d\n", _nb_modified_files);
+  g_printerr ("Unmodified files: %d\n", _nb_unmodified_files);
+}
+
+/* Adds the NUL-separated filenames contained in _files_from. */
+static gboolean
+add_filenames_from_file (GPtrArray  *filenames,
+                         GError    **error)
+{
+  gchar *contents;
+  gsize length;
+  gsize pos = 0;
+
+  if (g_str_equal (_files_from, "-"))
+    {
+      contents = get_stdin_contents (&length);
+    }
+  else if (!g_file_get_contents (_files_from, &contents, &length, error))
+    {
+      return FALSE;
+    }
+
+  while (pos < length)
+    {
+      const gchar *filename = contents + pos;
+      gsize filename_length = strnlen (filename, length - pos);
+
+      if (filename_length > 0)
+        g_ptr_array_add (filenames, g_strndup (filename, filename_length));
+
+      pos += filename_length + 1;
+    }
+
+  g_free (contents);
+  return TRUE;
+}
+
 int
-main (void)
+main (int    argc,
+      char **argv)
 {
+  GOptionContext *option_context;
+  GPtrArray *filenames;
+  GError *error = NULL;
   gchar *input_str;
+  gsize input_length;
+  GString *output;
+  gint i;
 
   setlocale (LC_ALL, "");
 
-  input_str = get_stdin_contents ();
-  align_params_on_parenthesis (input_str);
+  option_context = g_option_context_new ("- align parameters on the parenthesis");
+  g_option_context_add_main_entries (option_context, option_entries, NULL);
+  if (!g_option_context_parse (option_context, &argc, &argv, &error))
+    {
+      g_printerr ("Option parsing failed: %s\n", error->message);
+      g_printerr ("Run \"%s --help\" to see the options.\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+
+  g_option_context_free (option_context);
+
+  if (_socket_path != NULL && !_server)
+    {
+      g_printerr ("--socket can only be used with --server.\n");
+      return EXIT_FAILURE;
+    }
+
+  if (_server && _whole_file)
+    {
+      g_printerr ("--server and --whole-file can not be used together.\n");
+      return EXIT_FAILURE;
+    }
+
+  if ((argc > 1 || _files_from != NULL) && !_whole_file)
+    {
+      g_printerr ("Files can only be given with --whole-file.\n");
+      return EXIT_FAILURE;
+    }
+
+  if (_server)
+    {
+      if (_socket_path != NULL)
+        serve_socket (_socket_path);
+      else if (!serve_stdin ())
+        return EXIT_FAILURE;
+
+      return EXIT_SUCCESS;
+    }
+
+  if (_whole_file && (argc > 1 || _files_from != NULL))
+    {
+      filenames = g_ptr_array_new_with_free_func (g_free);
+
+      for (i = 1; i < argc; i++)
+        g_ptr_array_add (filenames, g_strdup (argv[i]));
+
+      if (_files_from != NULL &&
+          !add_filenames_from_file (filenames, &error))
+        {
+          g_printerr ("Impossible to read the list of files: %s\n", error->message);
+          return EXIT_FAILURE;
+        }
+
+      handle_files (filenames);
+      g_ptr_array_unref (filenames);
+
+      return _nb_errors > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+  input_str = get_stdin_contents (&input_length);
+  output = g_string_new (NULL);
+
+  if (_whole_file)
+    {
+      align_whole_file (input_str, input_length, output);
+      fwrite (output->str, 1, output->len, stdout);
+    }
+  else
+    {
+      align_params_on_parenthesis (input_str, output);
+      g_print ("%s", output->str);
+    }
 
+  g_free (input_str);
+  g_string_free (output, TRUE);
   return EXIT_SUCCESS;
 }
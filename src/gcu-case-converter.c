@@ -20,41 +20,140 @@
 /*
  * Usage:
  * $ gcu-case-converter (--to-uppercase|-u|--to-camelcase|-c|--to-lowercase|-l) word
+ * $ gcu-case-converter (--to-uppercase|-u|--to-camelcase|-c|--to-lowercase|-l) --stdin
  *
  * 'word' can initially be in UPPER_CASE, lower_case or CamelCase, it is
  * automatically detected.
  * Only one option must be provided.
  * The converted word is printed on stdout.
  * There can be warnings printed on stderr.
+ *
+ * With --stdin, the words are read from stdin, one per line, and the converted
+ * words are printed in the same order, one per line. It avoids launching one
+ * process per word when there are many words to convert. The output is written
+ * each time some input has been read, so it can also be used as a coprocess,
+ * one word at a time.
+ *
+ * With --all, the words given as arguments are converted to the three cases at
+ * once, printed as shell variable assignments, to be used with eval. A word can
+ * be given as PREFIX=word, the variables are then named PREFIX_uppercase,
+ * PREFIX_camelcase and PREFIX_lowercase, instead of uppercase, camelcase and
+ * lowercase. For example:
+ *
+ * $ eval "$(gcu-case-converter --all namespace=Gtk classname=SourceView)"
+ * $ echo $namespace_lowercase $classname_uppercase
+ * gtk SOURCE_VIEW
+ *
+ * With --all --json, one JSON object per word is printed instead, on one line,
+ * with the "prefix" (if given), "word", "uppercase", "camelcase" and
+ * "lowercase" members.
+ *
+ * With --prefix or --regex, the identifiers of C files are converted: only the
+ * identifiers starting with PREFIX, or entirely matching REGEX. For example to
+ * rename the functions of a namespace:
+ *
+ * $ gcu-case-converter --to-camelcase --prefix=gtk_source_ file.c
+ *
+ * The files are tokenized in one pass, the string and character literals, the
+ * comments, the numbers and the #include lines are left untouched. The files
+ * are modified in place, only if an identifier has changed. Without files,
+ * stdin is read and the result is written to stdout.
  */
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <locale.h>
-#include <glib.h>
+#include <unistd.h>
+#include <gio/gio.h>
+
+#define STDIN_BUFFER_SIZE (64 * 1024)
 
 typedef enum
 {
   GCU_CASE_TO_UPPERCASE,
   GCU_CASE_TO_CAMELCASE,
   GCU_CASE_TO_LOWERCASE,
+  GCU_CASE_NB_CASES
 } GcuCase;
 
+/* How to convert each char for a GcuCase, to not switch on the case for each
+ * char.
+ */
+typedef struct
+{
+  /* For the first char of a subword. */
+  gchar first_char[256];
+
+  /* For the other chars. */
+  gchar other_char[256];
+
+  /* Whether an underscore is inserted before each subword except the first. */
+  guint underscore_separator : 1;
+} CaseTable;
+
+static CaseTable case_tables[GCU_CASE_NB_CASES];
+
+/* For --all. */
+static const gchar *case_names[GCU_CASE_NB_CASES] =
+{
+  "uppercase",
+  "camelcase",
+  "lowercase"
+};
+
 static gboolean to_uppercase;
 static gboolean to_camelcase;
 static gboolean to_lowercase;
+static gboolean from_stdin;
+static gboolean all_cases;
+static gboolean json;
+static gchar *match_prefix;
+static gchar *match_regex;
+static gsize match_prefix_length;
+
+/* For --regex, anchored to match entire identifiers. */
+static GRegex *identifier_regex;
+
+static gint nb_errors;
+static gint nb_modified_files;
+static gint nb_unmodified_files;
+
+typedef enum
+{
+  LEX_STATE_CODE,
+  LEX_STATE_STRING,
+  LEX_STATE_CHAR,
+  LEX_STATE_BLOCK_COMMENT,
+  LEX_STATE_LINE_COMMENT
+} LexState;
 
 static GOptionEntry option_entries[] =
 {
   { "to-uppercase", 'u', 0, G_OPTION_ARG_NONE, &to_uppercase, "To UPPER_CASE", NULL },
   { "to-camelcase", 'c', 0, G_OPTION_ARG_NONE, &to_camelcase, "To CamelCase", NULL },
   { "to-lowercase", 'l', 0, G_OPTION_ARG_NONE, &to_lowercase, "To lower_case", NULL },
+  { "stdin", 0, 0, G_OPTION_ARG_NONE, &from_stdin, "Convert the words of stdin, one per line", NULL },
+  { "all", 'a', 0, G_OPTION_ARG_NONE, &all_cases,
+    "To the three cases, as shell variable assignments, for words given as [PREFIX=]word", NULL },
+  { "json", 0, 0, G_OPTION_ARG_NONE, &json, "With --all, print JSON objects instead", NULL },
+  { "prefix", 0, 0, G_OPTION_ARG_STRING, &match_prefix,
+    "Convert the identifiers starting with PREFIX in C files", "PREFIX" },
+  { "regex", 0, 0, G_OPTION_ARG_STRING, &match_regex,
+    "Convert the identifiers entirely matching REGEX in C files", "REGEX" },
   { NULL }
 };
 
 static void
 print_usage (char **argv)
 {
-  g_printerr ("Usage: %s (--to-uppercase|-u|--to-camelcase|-c|--to-lowercase|-l) word\n",
+  g_printerr ("Usage: %s (--to-uppercase|-u|--to-camelcase|-c|--to-lowercase|-l) (word|--stdin)\n",
+              argv[0]);
+  g_printerr ("       %s (--all|-a) [--json] [PREFIX=]word...\n",
+              argv[0]);
+  g_printerr ("       %s (--to-uppercase|-u|--to-camelcase|-c|--to-lowercase|-l) "
+              "(--prefix=PREFIX|--regex=REGEX) [file...]\n",
               argv[0]);
 }
 
@@ -123,83 +222,662 @@ starts_subword (gchar prev_char,
   return FALSE;
 }
 
+static void
+init_case_tables (void)
+{
+  gint c;
+
+  for (c = 0; c < 256; c++)
+    {
+      case_tables[GCU_CASE_TO_UPPERCASE].first_char[c] = g_ascii_toupper (c);
+      case_tables[GCU_CASE_TO_UPPERCASE].other_char[c] = g_ascii_toupper (c);
+
+      case_tables[GCU_CASE_TO_CAMELCASE].first_char[c] = g_ascii_toupper (c);
+      case_tables[GCU_CASE_TO_CAMELCASE].other_char[c] = g_ascii_tolower (c);
+
+      case_tables[GCU_CASE_TO_LOWERCASE].first_char[c] = g_ascii_tolower (c);
+      case_tables[GCU_CASE_TO_LOWERCASE].other_char[c] = g_ascii_tolower (c);
+    }
+
+  case_tables[GCU_CASE_TO_UPPERCASE].underscore_separator = TRUE;
+  case_tables[GCU_CASE_TO_CAMELCASE].underscore_separator = FALSE;
+  case_tables[GCU_CASE_TO_LOWERCASE].underscore_separator = TRUE;
+}
+
+/* Appends the converted word to @output. @word doesn't need to be
+ * nul-terminated.
+ *
+ * Returns: whether @word contains two contiguous underscores, which are not
+ * well supported.
+ */
+static gboolean
+append_converted_word (GString     *output,
+                       const gchar *word,
+                       gsize        length,
+                       GcuCase      to_case)
+{
+  const CaseTable *table = &case_tables[to_case];
+  gchar prev_char = '\0';
+  gboolean contiguous_underscores = FALSE;
+  gsize pos;
+
+  for (pos = 0; pos < length; pos++)
+    {
+      gchar cur_char = word[pos];
+
+      if (cur_char == '_')
+        {
+          if (prev_char == '_')
+            contiguous_underscores = TRUE;
+        }
+      else if (starts_subword (prev_char, cur_char))
+        {
+          if (pos > 0 && table->underscore_separator)
+            g_string_append_c (output, '_');
+          g_string_append_c (output, table->first_char[(guchar) cur_char]);
+        }
+      else
+        {
+          g_string_append_c (output, table->other_char[(guchar) cur_char]);
+        }
+
+      prev_char = cur_char;
+    }
+
+  return contiguous_underscores;
+}
+
 /* Returns: the converted word. Free with g_free(). */
 static gchar *
 convert_word (const gchar *word,
               GcuCase      to_case)
 {
   GString *converted_word;
-  gint pos;
-  gboolean warning_printed = FALSE;
 
   g_assert (word != NULL);
 
   converted_word = g_string_new (NULL);
 
-  for (pos = 0; word[pos] != '\0'; pos++)
-    {
-      gchar prev_char = '\0';
-      gchar cur_char = word[pos];
+  if (append_converted_word (converted_word, word, strlen (word), to_case))
+    g_printerr ("Two contiguous underscores are not well supported, check the result.\n");
 
-      if (pos > 0)
-        prev_char = word[pos-1];
+  return g_string_free (converted_word, FALSE);
+}
 
-      if (prev_char == '_' && cur_char == '_' && !warning_printed)
-        {
-          g_printerr ("Two contiguous underscores are not well supported, check the result.\n");
-          warning_printed = TRUE;
-        }
+static void
+append_converted_line (GString     *output,
+                       const gchar *line,
+                       gsize        length,
+                       guint        line_num,
+                       GcuCase      to_case)
+{
+  if (append_converted_word (output, line, length, to_case))
+    g_printerr ("Line %u: two contiguous underscores are not well supported, check the result.\n",
+                line_num);
 
-      if (cur_char == '_')
+  g_string_append_c (output, '\n');
+}
+
+static void
+write_output (GString *output)
+{
+  if (output->len == 0)
+    return;
+
+  if (fwrite (output->str, 1, output->len, stdout) != output->len ||
+      fflush (stdout) != 0)
+    g_error ("Impossible to write to stdout: %s", g_strerror (errno));
+
+  g_string_truncate (output, 0);
+}
+
+/* Converts the lines of stdin. A line split between two reads is kept in
+ * @partial_line, the other lines are converted directly from the buffer.
+ */
+static void
+convert_stdin (GcuCase to_case)
+{
+  gchar *buffer;
+  GString *partial_line;
+  GString *output;
+  guint line_num = 1;
+
+  buffer = g_malloc (STDIN_BUFFER_SIZE);
+  partial_line = g_string_new (NULL);
+  output = g_string_sized_new (STDIN_BUFFER_SIZE + STDIN_BUFFER_SIZE / 4);
+
+  while (TRUE)
+    {
+      gssize nb_bytes_read;
+      const gchar *pos;
+      const gchar *end;
+
+      nb_bytes_read = read (STDIN_FILENO, buffer, STDIN_BUFFER_SIZE);
+
+      if (nb_bytes_read == -1 && errno == EINTR)
         continue;
 
-      if (starts_subword (prev_char, cur_char))
+      if (nb_bytes_read == -1)
+        g_error ("Impossible to read stdin: %s", g_strerror (errno));
+
+      if (nb_bytes_read == 0)
+        break;
+
+      pos = buffer;
+      end = buffer + nb_bytes_read;
+
+      while (pos < end)
         {
-          switch (to_case)
+          const gchar *newline = memchr (pos, '\n', end - pos);
+
+          if (newline == NULL)
             {
-            case GCU_CASE_TO_UPPERCASE:
-              if (pos > 0)
-                g_string_append_c (converted_word, '_');
-              g_string_append_c (converted_word, g_ascii_toupper (cur_char));
+              g_string_append_len (partial_line, pos, end - pos);
               break;
+            }
 
-            case GCU_CASE_TO_CAMELCASE:
-              g_string_append_c (converted_word, g_ascii_toupper (cur_char));
-              break;
+          if (partial_line->len > 0)
+            {
+              g_string_append_len (partial_line, pos, newline - pos);
+              append_converted_line (output, partial_line->str, partial_line->len, line_num, to_case);
+              g_string_truncate (partial_line, 0);
+            }
+          else
+            {
+              append_converted_line (output, pos, newline - pos, line_num, to_case);
+            }
 
-            case GCU_CASE_TO_LOWERCASE:
-              if (pos > 0)
-                g_string_append_c (converted_word, '_');
-              g_string_append_c (converted_word, g_ascii_tolower (cur_char));
-              break;
+          line_num++;
+          pos = newline + 1;
+        }
 
-            default:
-              g_assert_not_reached ();
-            }
+      write_output (output);
+    }
+
+  /* Last line without a newline. */
+  if (partial_line->len > 0)
+    {
+      append_converted_line (output, partial_line->str, partial_line->len, line_num, to_case);
+      write_output (output);
+    }
+
+  g_free (buffer);
+  g_string_free (partial_line, TRUE);
+  g_string_free (output, TRUE);
+}
+
+/* A PREFIX must be usable in a shell variable name. */
+static gboolean
+is_valid_prefix (const gchar *prefix,
+                 gsize        length)
+{
+  gsize i;
+
+  if (length == 0 || g_ascii_isdigit (prefix[0]))
+    return FALSE;
+
+  for (i = 0; i < length; i++)
+    {
+      if (!g_ascii_isalnum (prefix[i]) && prefix[i] != '_')
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Splits "[PREFIX=]word". *prefix is set to NULL if there is no prefix. */
+static gboolean
+parse_prefixed_word (const gchar  *arg,
+                     gchar       **prefix,
+                     const gchar **word)
+{
+  const gchar *equal_sign = strchr (arg, '=');
+
+  *prefix = NULL;
+  *word = arg;
+
+  if (equal_sign == NULL)
+    return TRUE;
+
+  if (!is_valid_prefix (arg, equal_sign - arg))
+    return FALSE;
+
+  *prefix = g_strndup (arg, equal_sign - arg);
+  *word = equal_sign + 1;
+  return TRUE;
+}
+
+/* Quoted for the shell, between single quotes. */
+static void
+append_shell_string (GString     *output,
+                     const gchar *str)
+{
+  const gchar *p;
+
+  g_string_append_c (output, '\'');
+
+  for (p = str; *p != '\0'; p++)
+    {
+      if (*p == '\'')
+        g_string_append (output, "'\\''");
+      else
+        g_string_append_c (output, *p);
+    }
+
+  g_string_append_c (output, '\'');
+}
+
+static void
+append_json_string (GString     *json_output,
+                    const gchar *str)
+{
+  const gchar *p;
+
+  g_string_append_c (json_output, '"');
+
+  for (p = str; *p != '\0'; p++)
+    {
+      gchar c = *p;
+
+      if (c == '"' || c == '\\')
+        {
+          g_string_append_c (json_output, '\\');
+          g_string_append_c (json_output, c);
+        }
+      else if ((guchar) c < 0x20)
+        {
+          g_string_append_printf (json_output, "\\u%04x", (guint) c);
         }
       else
         {
-          switch (to_case)
-            {
-            case GCU_CASE_TO_UPPERCASE:
-              g_string_append_c (converted_word, g_ascii_toupper (cur_char));
-              break;
+          g_string_append_c (json_output, c);
+        }
+    }
 
-            case GCU_CASE_TO_CAMELCASE:
-              g_string_append_c (converted_word, g_ascii_tolower (cur_char));
-              break;
+  g_string_append_c (json_output, '"');
+}
 
-            case GCU_CASE_TO_LOWERCASE:
-              g_string_append_c (converted_word, g_ascii_tolower (cur_char));
-              break;
+static void
+append_all_cases (GString     *output,
+                  const gchar *prefix,
+                  const gchar *word)
+{
+  GString *converted_word;
+  gboolean contiguous_underscores = FALSE;
+  GcuCase to_case;
+
+  converted_word = g_string_new (NULL);
+
+  if (json)
+    {
+      g_string_append_c (output, '{');
 
-            default:
-              g_assert_not_reached ();
+      if (prefix != NULL)
+        {
+          g_string_append (output, "\"prefix\":");
+          append_json_string (output, prefix);
+          g_string_append_c (output, ',');
+        }
+
+      g_string_append (output, "\"word\":");
+      append_json_string (output, word);
+    }
+
+  for (to_case = 0; to_case < GCU_CASE_NB_CASES; to_case++)
+    {
+      g_string_truncate (converted_word, 0);
+      if (append_converted_word (converted_word, word, strlen (word), to_case))
+        contiguous_underscores = TRUE;
+
+      if (json)
+        {
+          g_string_append_printf (output, ",\"%s\":", case_names[to_case]);
+          append_json_string (output, converted_word->str);
+        }
+      else
+        {
+          if (prefix != NULL)
+            g_string_append_printf (output, "%s_", prefix);
+
+          g_string_append_printf (output, "%s=", case_names[to_case]);
+          append_shell_string (output, converted_word->str);
+          g_string_append_c (output, '\n');
+        }
+    }
+
+  if (json)
+    g_string_append (output, "}\n");
+
+  if (contiguous_underscores)
+    g_printerr ("%s: two contiguous underscores are not well supported, check the result.\n",
+                word);
+
+  g_string_free (converted_word, TRUE);
+}
+
+/* The output is printed only if all the arguments are valid, so that a
+ * script doesn't eval a partial output.
+ */
+static gboolean
+print_all_cases (gint    nb_words,
+                 char  **words)
+{
+  GString *output;
+  gboolean ok = TRUE;
+  gint i;
+
+  output = g_string_new (NULL);
+
+  for (i = 0; i < nb_words; i++)
+    {
+      gchar *prefix;
+      const gchar *word;
+
+      if (!parse_prefixed_word (words[i], &prefix, &word))
+        {
+          g_printerr ("Invalid prefix in \"%s\".\n", words[i]);
+          ok = FALSE;
+          break;
+        }
+
+      append_all_cases (output, prefix, word);
+      g_free (prefix);
+    }
+
+  if (ok)
+    g_print ("%s", output->str);
+
+  g_string_free (output, TRUE);
+  return ok;
+}
+
+static inline gboolean
+is_identifier_char (gchar c)
+{
+  return g_ascii_isalnum (c) || c == '_';
+}
+
+static gboolean
+identifier_matches (const gchar *identifier,
+                    gsize        length)
+{
+  if (match_prefix != NULL)
+    return (length >= match_prefix_length &&
+            memcmp (identifier, match_prefix, match_prefix_length) == 0);
+
+  return g_regex_match_full (identifier_regex, identifier, length, 0, 0, NULL, NULL);
+}
+
+/* Whether the '#' at @pos is the first non-blank char of its line, followed by
+ * "include" (or "import").
+ */
+static gboolean
+is_include_directive (const gchar *contents,
+                      gsize        length,
+                      gsize        pos)
+{
+  gsize i;
+
+  for (i = pos; i > 0 && contents[i - 1] != '\n'; i--)
+    {
+      if (contents[i - 1] != ' ' && contents[i - 1] != '\t')
+        return FALSE;
+    }
+
+  for (i = pos + 1; i < length && (contents[i] == ' ' || contents[i] == '\t'); i++)
+    ;
+
+  return ((length - i >= 7 && strncmp (contents + i, "include", 7) == 0) ||
+          (length - i >= 6 && strncmp (contents + i, "import", 6) == 0));
+}
+
+/* Advances @line_pos, the start of the line number @line_num, to the line
+ * containing @pos. The warnings are in order, so the lines are counted
+ * incrementally instead of from the start for each warning.
+ */
+static void
+count_lines (const gchar *contents,
+             gsize       *line_pos,
+             guint       *line_num,
+             gsize        pos)
+{
+  while (*line_pos < pos)
+    {
+      const gchar *newline = memchr (contents + *line_pos, '\n', pos - *line_pos);
+
+      if (newline == NULL)
+        break;
+
+      (*line_num)++;
+      *line_pos = newline + 1 - contents;
+    }
+}
+
+/* One pass on @contents. The unmodified parts are copied to @output in runs,
+ * between the converted identifiers.
+ */
+static void
+convert_identifiers (const gchar *contents,
+                     gsize        length,
+                     const gchar *filename,
+                     GcuCase      to_case,
+                     GString     *output)
+{
+  LexState state = LEX_STATE_CODE;
+  gsize copy_start = 0;
+  gsize pos = 0;
+  gsize line_pos = 0;
+  guint line_num = 1;
+
+  while (pos < length)
+    {
+      gchar c = contents[pos];
+      gchar next_char = pos + 1 < length ? contents[pos + 1] : '\0';
+      gsize end;
+
+      switch (state)
+        {
+        case LEX_STATE_CODE:
+          if (c == '/' && next_char == '*')
+            {
+              state = LEX_STATE_BLOCK_COMMENT;
+              pos += 2;
+            }
+          else if (c == '/' && next_char == '/')
+            {
+              state = LEX_STATE_LINE_COMMENT;
+              pos += 2;
             }
+          else if (c == '"')
+            {
+              state = LEX_STATE_STRING;
+              pos++;
+            }
+          else if (c == '\'')
+            {
+              state = LEX_STATE_CHAR;
+              pos++;
+            }
+          else if (c == '#' && is_include_directive (contents, length, pos))
+            {
+              /* The header name is not a string literal with <...>. */
+              state = LEX_STATE_LINE_COMMENT;
+              pos++;
+            }
+          else if (g_ascii_isdigit (c))
+            {
+              /* A number, with its suffix (e.g. 10UL or 0x1Fu). */
+              for (pos++; pos < length && (is_identifier_char (contents[pos]) || contents[pos] == '.'); pos++)
+                ;
+            }
+          else if (is_identifier_char (c))
+            {
+              for (end = pos + 1; end < length && is_identifier_char (contents[end]); end++)
+                ;
+
+              if (identifier_matches (contents + pos, end - pos))
+                {
+                  g_string_append_len (output, contents + copy_start, pos - copy_start);
+
+                  if (append_converted_word (output, contents + pos, end - pos, to_case))
+                    {
+                      count_lines (contents, &line_pos, &line_num, pos);
+                      g_printerr ("%s:%u: two contiguous underscores are not well supported, "
+                                  "check the result.\n",
+                                  filename,
+                                  line_num);
+                    }
+
+                  copy_start = end;
+                }
+
+              pos = end;
+            }
+          else
+            {
+              pos++;
+            }
+          break;
+
+        case LEX_STATE_STRING:
+        case LEX_STATE_CHAR:
+          if (c == '\\')
+            pos++;
+          else if ((c == '"' && state == LEX_STATE_STRING) ||
+                   (c == '\'' && state == LEX_STATE_CHAR) ||
+                   c == '\n')
+            state = LEX_STATE_CODE;
+          pos++;
+          break;
+
+        case LEX_STATE_BLOCK_COMMENT:
+          if (c == '*' && next_char == '/')
+            {
+              state = LEX_STATE_CODE;
+              pos++;
+            }
+          pos++;
+          break;
+
+        case LEX_STATE_LINE_COMMENT:
+          if (c == '\n')
+            state = LEX_STATE_CODE;
+          pos++;
+          break;
+
+        default:
+          g_assert_not_reached ();
         }
     }
 
-  return g_string_free (converted_word, FALSE);
+  if (pos > length)
+    pos = length;
+
+  g_string_append_len (output, contents + copy_start, pos - copy_start);
+}
+
+static gboolean
+convert_file (const gchar  *filename,
+              GcuCase       to_case,
+              GError      **error)
+{
+  GFile *file;
+  gchar *contents = NULL;
+  gsize length;
+  GString *output = NULL;
+  gboolean ok = FALSE;
+
+  file = g_file_new_for_commandline_arg (filename);
+
+  if (!g_file_load_contents (file, NULL, &contents, &length, NULL, error))
+    goto out;
+
+  output = g_string_sized_new (length);
+  convert_identifiers (contents, length, filename, to_case, output);
+
+  if (output->len == length &&
+      memcmp (output->str, contents, length) == 0)
+    {
+      nb_unmodified_files++;
+      ok = TRUE;
+      goto out;
+    }
+
+  ok = g_file_replace_contents (file,
+                                output->str,
+                                output->len,
+                                NULL,
+                                FALSE,
+                                G_FILE_CREATE_NONE,
+                                NULL,
+                                NULL,
+                                error);
+
+  if (ok)
+    nb_modified_files++;
+
+out:
+  g_object_unref (file);
+  g_free (contents);
+  if (output != NULL)
+    g_string_free (output, TRUE);
+  return ok;
+}
+
+static void
+convert_files (gint      nb_files,
+               char    **filenames,
+               GcuCase   to_case)
+{
+  gint i;
+
+  for (i = 0; i < nb_files; i++)
+    {
+      GError *error = NULL;
+
+      if (!convert_file (filenames[i], to_case, &error))
+        {
+          g_printerr ("%s: %s\n", filenames[i], error->message);
+          g_error_free (error);
+          nb_errors++;
+        }
+    }
+
+  g_printerr ("Modified files: %d\n", nb_modified_files);
+  g_printerr ("Unmodified files: %d\n", nb_unmodified_files);
+}
+
+static void
+convert_stdin_identifiers (GcuCase to_case)
+{
+  GString *contents;
+  GString *output;
+
+  contents = g_string_new (NULL);
+
+  while (TRUE)
+    {
+      gchar buffer[STDIN_BUFFER_SIZE];
+      gssize nb_bytes_read = read (STDIN_FILENO, buffer, sizeof (buffer));
+
+      if (nb_bytes_read == -1 && errno == EINTR)
+        continue;
+
+      if (nb_bytes_read == -1)
+        g_error ("Impossible to read stdin: %s", g_strerror (errno));
+
+      if (nb_bytes_read == 0)
+        break;
+
+      g_string_append_len (contents, buffer, nb_bytes_read);
+    }
+
+  output = g_string_sized_new (contents->len);
+  convert_identifiers (contents->str, contents->len, "stdin", to_case, output);
+  write_output (output);
+
+  g_string_free (contents, TRUE);
+  g_string_free (output, TRUE);
 }
 
 int
@@ -225,7 +903,83 @@ main (int    argc,
       goto exit;
     }
 
-  if (argc != 2)
+  if (all_cases)
+    {
+      if (to_uppercase || to_camelcase || to_lowercase || from_stdin ||
+          match_prefix != NULL || match_regex != NULL)
+        {
+          g_printerr ("--all can not be used with the other options, except --json.\n");
+          print_usage (argv);
+          ret = EXIT_FAILURE;
+          goto exit;
+        }
+
+      if (argc < 2)
+        {
+          print_usage (argv);
+          ret = EXIT_FAILURE;
+          goto exit;
+        }
+
+      init_case_tables ();
+
+      if (!print_all_cases (argc - 1, argv + 1))
+        ret = EXIT_FAILURE;
+
+      goto exit;
+    }
+
+  if (json)
+    {
+      g_printerr ("--json can only be used with --all.\n");
+      print_usage (argv);
+      ret = EXIT_FAILURE;
+      goto exit;
+    }
+
+  if (match_prefix != NULL || match_regex != NULL)
+    {
+      if (from_stdin || (match_prefix != NULL && match_regex != NULL))
+        {
+          g_printerr ("--prefix and --regex can not be used together, nor with --stdin.\n");
+          print_usage (argv);
+          ret = EXIT_FAILURE;
+          goto exit;
+        }
+
+      if (match_regex != NULL)
+        {
+          gchar *anchored_pattern = g_strdup_printf ("^(?:%s)$", match_regex);
+
+          identifier_regex = g_regex_new (anchored_pattern, G_REGEX_OPTIMIZE, 0, &error);
+          g_free (anchored_pattern);
+
+          if (identifier_regex == NULL)
+            {
+              g_printerr ("Invalid regex: %s\n", error->message);
+              ret = EXIT_FAILURE;
+              goto exit;
+            }
+        }
+
+      if (match_prefix != NULL)
+        match_prefix_length = strlen (match_prefix);
+
+      to_case = get_case (argv);
+      init_case_tables ();
+
+      if (argc > 1)
+        convert_files (argc - 1, argv + 1, to_case);
+      else
+        convert_stdin_identifiers (to_case);
+
+      if (nb_errors > 0)
+        ret = EXIT_FAILURE;
+
+      goto exit;
+    }
+
+  if (argc != (from_stdin ? 1 : 2))
     {
       print_usage (argv);
       ret = EXIT_FAILURE;
@@ -233,6 +987,14 @@ main (int    argc,
     }
 
   to_case = get_case (argv);
+  init_case_tables ();
+
+  if (from_stdin)
+    {
+      convert_stdin (to_case);
+      goto exit;
+    }
+
   word = argv[1];
   converted_word = convert_word (word, to_case);
   g_print ("%s\n", converted_word);
@@ -241,5 +1003,7 @@ main (int    argc,
 exit:
   g_option_context_free (option_context);
   g_clear_error (&error);
+  if (identifier_regex != NULL)
+    g_regex_unref (identifier_regex);
   return ret;
 }
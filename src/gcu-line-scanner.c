@@ -0,0 +1,431 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2013, 2014, 2016, 2017 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Classifies a line of C code as a function name, a parameter or an opening
+ * curly brace, as used by gcu-lineup-parameters.
+ *
+ * gcu_line_scanner_scan_with_regex() is the reference implementation, with the
+ * regexes written in gcu-line-scanner.h.
+ *
+ * gcu_line_scanner_scan() gives exactly the same results, but with a
+ * hand-written scanner that does one left-to-right pass on the line. GRegex
+ * is used with Unicode semantics, so \w and \s match some non-ASCII characters
+ * too. As soon as the scanner needs to classify a non-ASCII byte, it gives up
+ * and falls back to the regexes. In practice it almost never happens, the
+ * identifiers and the whitespace in C code are ASCII.
+ *
+ * Both functions can be called from several threads.
+ */
+
+#include "gcu-line-scanner.h"
+#include <string.h>
+
+typedef enum
+{
+  SCAN_NO_MATCH,
+  SCAN_MATCH,
+  SCAN_FALLBACK
+} ScanResult;
+
+static inline gboolean
+is_ascii (gchar c)
+{
+  return (guchar) c < 0x80;
+}
+
+/* \w for an ASCII char. */
+static inline gboolean
+is_word_char (gchar c)
+{
+  return g_ascii_isalnum (c) || c == '_';
+}
+
+/* \s for an ASCII char. */
+static inline gboolean
+is_space_char (gchar c)
+{
+  return (c == ' ' ||
+          c == '\t' ||
+          c == '\n' ||
+          c == '\v' ||
+          c == '\f' ||
+          c == '\r');
+}
+
+/* Advances *pos while there is a \w char. Returns FALSE if stopped on a
+ * non-ASCII char.
+ */
+static inline gboolean
+skip_word_chars (const gchar *line,
+                 gsize        length,
+                 gsize       *pos)
+{
+  while (*pos < length && is_word_char (line[*pos]))
+    (*pos)++;
+
+  return *pos == length || is_ascii (line[*pos]);
+}
+
+/* Same for \s. */
+static inline gboolean
+skip_space_chars (const gchar *line,
+                  gsize        length,
+                  gsize       *pos)
+{
+  while (*pos < length && is_space_char (line[*pos]))
+    (*pos)++;
+
+  return *pos == length || is_ascii (line[*pos]);
+}
+
+/* "^(\w+) ?\(" */
+static ScanResult
+scan_function_name (const gchar *line,
+                    gsize        length,
+                    GcuLineInfo *info)
+{
+  gsize pos = 0;
+
+  if (!skip_word_chars (line, length, &pos))
+    return SCAN_FALLBACK;
+
+  if (pos == 0)
+    return SCAN_NO_MATCH;
+
+  info->function_name_length = pos;
+
+  if (pos < length && line[pos] == ' ')
+    pos++;
+
+  if (pos < length && line[pos] == '(')
+    {
+      info->is_function_name = TRUE;
+      info->first_param_pos = pos + 1;
+      return SCAN_MATCH;
+    }
+
+  info->function_name_length = 0;
+  return SCAN_NO_MATCH;
+}
+
+/* "^\s*(?<type>(const\s+)?\w+)\s+(?<stars>\**)\s*(?<name>\w+)\s*(?<end>,|\);?|;)\s*$"
+ *
+ * Each part of the regex can match in only one way, except the optional
+ * "const\s+" group: it is first tried with @with_const, and if it doesn't
+ * match, without. With @with_const, SCAN_NO_MATCH is returned if the type
+ * doesn't start with "const\s+", since it would be the same as without.
+ *
+ * When ended by ";", it is a struct member instead of a parameter.
+ */
+static ScanResult
+scan_parameter (const gchar *line,
+                gsize        length,
+                gsize        start_pos,
+                gboolean     with_const,
+                GcuLineInfo *info)
+{
+  gsize pos = start_pos;
+  gsize type_pos;
+  gsize type_end;
+  gsize stars_pos;
+  gsize nb_stars;
+  gsize name_pos;
+  gsize name_end;
+  gboolean is_last_parameter = FALSE;
+  gboolean is_prototype_end = FALSE;
+  gboolean is_struct_member = FALSE;
+
+  if (!skip_space_chars (line, length, &pos))
+    return SCAN_FALLBACK;
+
+  type_pos = pos;
+
+  if (with_const)
+    {
+      if (length - pos <= 5 ||
+          strncmp (line + pos, "const", 5) != 0)
+        return SCAN_NO_MATCH;
+
+      pos += 5;
+
+      if (!is_ascii (line[pos]))
+        return SCAN_FALLBACK;
+
+      if (!is_space_char (line[pos]))
+        return SCAN_NO_MATCH;
+
+      if (!skip_space_chars (line, length, &pos))
+        return SCAN_FALLBACK;
+    }
+
+  type_end = pos;
+  if (!skip_word_chars (line, length, &type_end))
+    return SCAN_FALLBACK;
+  if (type_end == pos)
+    return SCAN_NO_MATCH;
+
+  pos = type_end;
+  if (pos == length || !is_space_char (line[pos]))
+    return SCAN_NO_MATCH;
+  if (!skip_space_chars (line, length, &pos))
+    return SCAN_FALLBACK;
+
+  stars_pos = pos;
+  while (pos < length && line[pos] == '*')
+    pos++;
+  nb_stars = pos - stars_pos;
+
+  if (!skip_space_chars (line, length, &pos))
+    return SCAN_FALLBACK;
+
+  name_pos = pos;
+  name_end = pos;
+  if (!skip_word_chars (line, length, &name_end))
+    return SCAN_FALLBACK;
+  if (name_end == name_pos)
+    return SCAN_NO_MATCH;
+
+  pos = name_end;
+  if (!skip_space_chars (line, length, &pos))
+    return SCAN_FALLBACK;
+
+  if (pos == length)
+    return SCAN_NO_MATCH;
+
+  if (line[pos] == ')')
+    is_last_parameter = TRUE;
+  else if (line[pos] == ';')
+    is_struct_member = TRUE;
+  else if (line[pos] != ',')
+    return SCAN_NO_MATCH;
+
+  pos++;
+
+  if (is_last_parameter && pos < length && line[pos] == ';')
+    {
+      is_prototype_end = TRUE;
+      pos++;
+    }
+
+  if (!skip_space_chars (line, length, &pos))
+    return SCAN_FALLBACK;
+  if (pos != length)
+    return SCAN_NO_MATCH;
+
+  info->is_parameter = !is_struct_member;
+  info->is_last_parameter = is_last_parameter;
+  info->is_prototype_end = is_prototype_end;
+  info->is_struct_member = is_struct_member;
+  info->type_pos = type_pos;
+  info->type_length = type_end - type_pos;
+  info->nb_stars = nb_stars;
+  info->name_pos = name_pos;
+  info->name_length = name_end - name_pos;
+  return SCAN_MATCH;
+}
+
+/* "^{\s*$" */
+static ScanResult
+scan_opening_curly_brace (const gchar *line,
+                          gsize        length,
+                          GcuLineInfo *info)
+{
+  gsize pos = 1;
+
+  if (length == 0 || line[0] != '{')
+    return SCAN_NO_MATCH;
+
+  if (!skip_space_chars (line, length, &pos))
+    return SCAN_FALLBACK;
+  if (pos != length)
+    return SCAN_NO_MATCH;
+
+  info->is_opening_curly_brace = TRUE;
+  return SCAN_MATCH;
+}
+
+static void
+reset_info (GcuLineInfo *info)
+{
+  memset (info, 0, sizeof (GcuLineInfo));
+}
+
+void
+gcu_line_scanner_scan (const gchar *line,
+                       gsize        length,
+                       GcuLineInfo *info)
+{
+  ScanResult result;
+  gsize params_pos;
+
+  g_return_if_fail (line != NULL || length == 0);
+  g_return_if_fail (info != NULL);
+
+  reset_info (info);
+
+  result = scan_function_name (line, length, info);
+  if (result == SCAN_FALLBACK)
+    goto fallback;
+
+  if (result == SCAN_MATCH)
+    {
+      params_pos = info->first_param_pos;
+    }
+  else
+    {
+      params_pos = 0;
+
+      if (scan_opening_curly_brace (line, length, info) == SCAN_FALLBACK)
+        goto fallback;
+    }
+
+  result = scan_parameter (line, length, params_pos, TRUE, info);
+  if (result == SCAN_NO_MATCH)
+    result = scan_parameter (line, length, params_pos, FALSE, info);
+
+  if (result == SCAN_FALLBACK)
+    goto fallback;
+
+  return;
+
+fallback:
+  gcu_line_scanner_scan_with_regex (line, length, info);
+}
+
+static GRegex *
+get_function_name_regex (void)
+{
+  static GRegex *regex = NULL;
+
+  if (g_once_init_enter (&regex))
+    {
+      GRegex *new_regex = g_regex_new ("^(\\w+) ?\\(", G_REGEX_OPTIMIZE, 0, NULL);
+      g_once_init_leave (&regex, new_regex);
+    }
+
+  return regex;
+}
+
+static GRegex *
+get_parameter_regex (void)
+{
+  static GRegex *regex = NULL;
+
+  if (g_once_init_enter (&regex))
+    {
+      GRegex *new_regex;
+
+      new_regex = g_regex_new ("^\\s*(?<type>(const\\s+)?\\w+)\\s+(?<stars>\\**)\\s*(?<name>\\w+)\\s*(?<end>,|\\);?|;)\\s*$",
+                               G_REGEX_OPTIMIZE,
+                               0,
+                               NULL);
+
+      g_once_init_leave (&regex, new_regex);
+    }
+
+  return regex;
+}
+
+static GRegex *
+get_opening_curly_brace_regex (void)
+{
+  static GRegex *regex = NULL;
+
+  if (g_once_init_enter (&regex))
+    {
+      GRegex *new_regex = g_regex_new ("^{\\s*$", G_REGEX_OPTIMIZE, 0, NULL);
+      g_once_init_leave (&regex, new_regex);
+    }
+
+  return regex;
+}
+
+void
+gcu_line_scanner_scan_with_regex (const gchar *line,
+                                  gsize        length,
+                                  GcuLineInfo *info)
+{
+  GMatchInfo *match_info;
+  const gchar *params;
+  gint start_pos;
+  gint end_pos;
+  gint params_pos = 0;
+
+  g_return_if_fail (line != NULL || length == 0);
+  g_return_if_fail (info != NULL);
+
+  reset_info (info);
+
+  if (length == 0)
+    line = "";
+
+  g_regex_match_full (get_function_name_regex (), line, length, 0, 0, &match_info, NULL);
+
+  if (g_match_info_matches (match_info) &&
+      g_match_info_fetch_pos (match_info, 1, NULL, &end_pos) &&
+      g_match_info_fetch_pos (match_info, 0, NULL, &params_pos))
+    {
+      info->is_function_name = TRUE;
+      info->function_name_length = end_pos;
+      info->first_param_pos = params_pos;
+    }
+
+  g_match_info_free (match_info);
+
+  /* Match on the substring, for "^" to match just after the function name. */
+  params = line + params_pos;
+
+  g_regex_match_full (get_parameter_regex (),
+                      params, length - params_pos, 0, 0,
+                      &match_info, NULL);
+
+  if (g_match_info_matches (match_info))
+    {
+      g_match_info_fetch_named_pos (match_info, "end", &start_pos, &end_pos);
+
+      if (params[start_pos] == ';')
+        {
+          info->is_struct_member = TRUE;
+        }
+      else
+        {
+          info->is_parameter = TRUE;
+          info->is_last_parameter = params[start_pos] == ')';
+          info->is_prototype_end = end_pos - start_pos == 2;
+        }
+
+      g_match_info_fetch_named_pos (match_info, "type", &start_pos, &end_pos);
+      info->type_pos = params_pos + start_pos;
+      info->type_length = end_pos - start_pos;
+
+      g_match_info_fetch_named_pos (match_info, "stars", &start_pos, &end_pos);
+      info->nb_stars = end_pos - start_pos;
+
+      g_match_info_fetch_named_pos (match_info, "name", &start_pos, &end_pos);
+      info->name_pos = params_pos + start_pos;
+      info->name_length = end_pos - start_pos;
+    }
+
+  g_match_info_free (match_info);
+
+  info->is_opening_curly_brace = g_regex_match_full (get_opening_curly_brace_regex (),
+                                                     line, length, 0, 0,
+                                                     NULL, NULL);
+}
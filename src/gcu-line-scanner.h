@@ -0,0 +1,73 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2013, 2014, 2016, 2017 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GCU_LINE_SCANNER_H
+#define GCU_LINE_SCANNER_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* What a line of a function declaration can be. The positions are byte
+ * offsets from the start of the line.
+ */
+typedef struct
+{
+  /* "^(\w+) ?\(" */
+  guint is_function_name : 1;
+
+  /* "^\s*(?<type>(const\s+)?\w+)\s+(?<stars>\**)\s*(?<name>\w+)\s*(?<end>,|\);?|;)\s*$"
+   * matched after the function name if there is one, at the start of the
+   * line otherwise.
+   */
+  guint is_parameter : 1;
+  guint is_last_parameter : 1;
+
+  /* The last parameter of a prototype, ended by ");". */
+  guint is_prototype_end : 1;
+
+  /* Ended by ";" instead: a struct member. It is not a parameter, but the
+   * type, stars and name are set the same way.
+   */
+  guint is_struct_member : 1;
+
+  /* "^{\s*$" */
+  guint is_opening_curly_brace : 1;
+
+  gsize function_name_length;
+  gsize first_param_pos;
+
+  gsize type_pos;
+  gsize type_length;
+  guint nb_stars;
+  gsize name_pos;
+  gsize name_length;
+} GcuLineInfo;
+
+void    gcu_line_scanner_scan               (const gchar *line,
+                                             gsize        length,
+                                             GcuLineInfo *info);
+
+void    gcu_line_scanner_scan_with_regex    (const gchar *line,
+                                             gsize        length,
+                                             GcuLineInfo *info);
+
+G_END_DECLS
+
+#endif /* GCU_LINE_SCANNER_H */
@@ -20,21 +20,85 @@
 /*
  * Line up parameters of function declarations.
  *
- * Usage: gcu-lineup-parameters [--tabs|-t] [file]
+ * Usage: gcu-lineup-parameters [--tabs|-t] [--jobs|-j N] [--chunk-size MiB]
+ *                              [--files-from FILE] [--structs] [--check [--all]]
+ *                              [--dump-signatures] [--lines A:B...] [--diff] [file...]
  * If no files are given, stdin is read and the result is printed to stdout.
- * If 'file' is given, its content is directly modified (WARNING: no backup is
- * made first!).
+ * Stdin is processed as a stream, so big inputs can be piped through
+ * gcu-lineup-parameters with a constant memory usage.
+ * If files are given, their contents are directly modified (WARNING: no backup
+ * is made first!). A file is not written if its content doesn't change, so
+ * its modification time is kept. The number of modified and unmodified files
+ * is printed at the end.
+ *
+ * The files are processed in parallel in the same process, with N threads
+ * (by default the number of processors). With --files-from, the list of files
+ * is read from FILE, or from stdin if FILE is "-". The filenames in FILE must
+ * be separated by NUL characters, for example:
+ * $ find . -name "*.c" -print0 | gcu-lineup-parameters --files-from -
+ *
+ * A big file (for example generated code) can also be processed in parallel:
+ * with --chunk-size, a file bigger than MiB mebibytes is split in chunks of
+ * about that size, which are processed by N threads too. The result is the
+ * same as when the file is processed at once. The chunks are used only when
+ * the files are processed one at a time (one file, or --jobs=1), the threads
+ * are otherwise already busy with the other files.
+ *
+ * With --check, the files are not modified. Instead, the function declarations
+ * that would be modified are listed on stderr as "file:line:function_name"
+ * (or "file:line:struct _Name" with --structs), and the exit status is
+ * non-zero if there is at least one. Only the first one of each file is
+ * listed, unless --all is given.
+ *
+ * With --dump-signatures, the files are not modified either. The function
+ * declarations are printed as JSON Lines, one object per declaration:
+ * {"file":"foo.c","line":12,"function":"foo_new","prototype":false,
+ *  "parameters":[{"type":"const gchar","stars":1,"name":"name"}]}
+ * (on one line). The restrictions below apply, so it is not a full C parser:
+ * for example a function without parameters ("void") is not listed. But it is
+ * fast enough to index a big source tree.
+ *
+ * To not touch the rest of the files, the modifications can be restricted to
+ * the function declarations overlapping some lines. With --lines A:B (can be
+ * given several times), only the lines A to B of the files are considered,
+ * the first line being 1. With --diff, a unified diff is read on stdin, and
+ * only the added and modified lines of the files in the diff are considered,
+ * plus the lines around the deleted lines. Only the *.c and *.h files of the
+ * diff are modified, and the git "b/" prefix of the filenames is removed, for
+ * example:
+ * $ git diff -U0 | gcu-lineup-parameters --diff
+ * The other lines are not scanned, so it is fast even on big files.
  *
  * By default gcu-lineup-parameters aligns parameters on the parenthesis with
  * spaces only. With the --tabs option, tabs+spaces will be inserted.
  *
+ * With --structs, the members of the structs are aligned too, in the same
+ * pass and with the same rules as the parameters:
+ *
+ * struct _FrobnitzPrivate
+ * {
+ *   GtkWidget *widget;
+ *   gint       magic_number;
+ *   GError   **error;
+ * };
+ *
+ * The struct must start with "struct", "struct _Name", "typedef struct" or
+ * "typedef struct _Name" at column 0, followed by a "{" line, and end with a
+ * line like "};" or "} Name;". Each member must follow the same rules as a
+ * parameter, with ";" instead of "," or ")". Empty lines and one-line
+ * comments are allowed between the members. Otherwise (for example with a bit
+ * field, an array or a function pointer) the struct is not modified.
+ *
  * The restrictions:
  * - The function name must be at column 0, followed by a space and an opening
  *   parenthesis;
  * - One parameter per line;
- * - A parameter must follow certain rules (see the regex in the code), but it
- *   doesn't accept all possibilities of the C language.
- * - The opening curly brace ("{") of the function must also be at column 0.
+ * - A parameter must follow certain rules (see the regex in
+ *   gcu-line-scanner.h), but it doesn't accept all possibilities of the C
+ *   language.
+ * - The opening curly brace ("{") of the function must also be at column 0,
+ *   or, for a prototype (in a header for example), the last parameter must be
+ *   followed by ");".
  *
  * If one restriction is missing, the function declaration is not modified.
  *
@@ -97,221 +161,644 @@
 #include <string.h>
 #include <locale.h>
 #include <unistd.h>
+#include "gcu-line-scanner.h"
+
+#define STDIN_CHUNK_SIZE (64 * 1024)
 
+/* The positions are byte offsets in the parsed contents. */
 typedef struct
 {
-  gchar *type;
+  gsize type_pos;
+  gsize type_length;
   guint nb_stars;
-  gchar *name;
+  gsize name_pos;
+  gsize name_length;
+
+  /* The start of the line, for the indentation of a struct member. */
+  gsize line_pos;
 } ParameterInfo;
 
+typedef enum
+{
+  DECLARATION_NOT_FOUND,
+  DECLARATION_FOUND,
+
+  /* The contents ends before knowing if it is a function declaration. */
+  DECLARATION_INCOMPLETE
+} DeclarationResult;
+
+typedef struct
+{
+  const gchar *contents;
+  gsize length;
+
+  /* Whether the end of the contents is the end of the input. If FALSE, the
+   * contents ends with a newline and more lines will follow.
+   */
+  guint is_end : 1;
+
+  /* The whole output is built in memory, and written at once. */
+  GString *output;
+
+  /* If not NULL, the parser only checks the alignment: the positions of the
+   * function declarations that would be modified are appended, and @output
+   * is used only as a scratch buffer.
+   */
+  GArray *misaligned_declarations;
+
+  /* If not NULL, the parser doesn't modify anything: the positions of all the
+   * function declarations are appended, and @output is not used.
+   */
+  GArray *declarations;
+
+  /* Only the function declarations overlapping [modify_start, modify_end)
+   * are modified. The others are kept as is.
+   */
+  gsize modify_start;
+  gsize modify_end;
+
+  /* The ParameterInfos of the current function declaration. The GArray is
+   * reused for all the function declarations, to not allocate memory for
+   * each parameter.
+   */
+  GArray *parameter_infos;
+
+  /* Whether the current function declaration is a prototype, ended by ");"
+   * instead of an opening curly brace.
+   */
+  guint is_prototype : 1;
+
+  /* Whether the current declaration is a struct, with --structs. Its
+   * members are in @parameter_infos.
+   */
+  guint is_struct : 1;
+
+  /* With --structs, the start of the next struct before @struct_search_end,
+   * or @struct_search_end if there is none. Valid for the same end if the
+   * current position is between @struct_search_pos and @next_struct_pos.
+   */
+  gsize struct_search_pos;
+  gsize struct_search_end;
+  gsize next_struct_pos;
+} Parser;
+
+/* For --lines and --diff. The line numbers start at 1, @last included. */
+typedef struct
+{
+  guint first;
+  guint last;
+} LineRange;
+
+/* A LineRange converted to byte offsets, @end excluded. */
+typedef struct
+{
+  gsize start;
+  gsize end;
+} ByteRange;
+
+/* A part of a big file, parsed in a separate thread. */
+typedef struct
+{
+  const gchar *contents;
+  gsize length;
+  gsize start;
+  gsize end;
+  GString *output;
+} Chunk;
+
 static gboolean _tabs;
+static gboolean _structs;
+static gint _jobs;
+static gint _chunk_size;
+static gchar *_files_from;
+static gboolean _check;
+static gboolean _check_all;
+static gboolean _dump_signatures;
+static gchar **_lines;
+static gboolean _diff;
+
+/* The sorted and merged LineRanges of --lines, for all the files. */
+static GArray *_line_ranges;
+
+/* With --diff, filename -> sorted and merged LineRanges. */
+static GHashTable *_diff_line_ranges;
+
+/* Whether the files are processed by a GThreadPool. A big file is then not
+ * split in chunks, to not create a second pool in each worker.
+ */
+static gboolean _files_in_parallel;
+
+/* Incremented from the worker threads. */
+static gint _nb_errors;
+static gint _nb_modified_files;
+static gint _nb_unmodified_files;
+static gint _nb_misaligned_files;
 
 static GOptionEntry option_entries[] =
 {
   { "tabs", 't', 0, G_OPTION_ARG_NONE, &_tabs,
     "Use tabs to align parameters on the parenthesis.", NULL },
+  { "structs", 0, 0, G_OPTION_ARG_NONE, &_structs,
+    "Also align the members of the structs.", NULL },
+  { "jobs", 'j', 0, G_OPTION_ARG_INT, &_jobs,
+    "Number of files to process in parallel (default: number of processors).", "N" },
+  { "chunk-size", 0, 0, G_OPTION_ARG_INT, &_chunk_size,
+    "Split the files bigger than MiB mebibytes in chunks of that size, processed in parallel "
+    "(default: 0, disabled).", "MiB" },
+  { "files-from", 0, 0, G_OPTION_ARG_FILENAME, &_files_from,
+    "Read NUL-separated filenames from FILE (\"-\" for stdin).", "FILE" },
+  { "check", 0, 0, G_OPTION_ARG_NONE, &_check,
+    "Don't modify the files, list the misaligned function declarations.", NULL },
+  { "all", 0, 0, G_OPTION_ARG_NONE, &_check_all,
+    "With --check, list all the misaligned function declarations of a file, "
+    "not only the first one.", NULL },
+  { "dump-signatures", 0, 0, G_OPTION_ARG_NONE, &_dump_signatures,
+    "Don't modify the files, print the function declarations as JSON Lines.", NULL },
+  { "lines", 0, 0, G_OPTION_ARG_STRING_ARRAY, &_lines,
+    "Modify only the function declarations overlapping the lines A to B "
+    "(can be given several times).", "A:B" },
+  { "diff", 0, 0, G_OPTION_ARG_NONE, &_diff,
+    "Read a unified diff on stdin, and modify only the function declarations "
+    "overlapping the changed lines of the files in the diff.", NULL },
   { NULL }
 };
 
 static void
 print_usage (char **argv)
 {
-  g_printerr ("Usage: %s [--tabs|-t] [file]\n", argv[0]);
+  g_printerr ("Usage: %s [OPTION...] [file...]\n", argv[0]);
+  g_printerr ("Run \"%s --help\" to see the options.\n", argv[0]);
 }
 
+/* To append padding without allocating it first. */
+static const gchar spaces_run[] = "                                        ";
+static const gchar tabs_run[] = "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
+static const gchar stars_run[] = "********";
+
 static void
-parameter_info_free (ParameterInfo *param_info)
+append_run (GString     *output,
+            const gchar *run,
+            gsize        run_length,
+            gsize        n)
 {
-  g_free (param_info->type);
-  g_free (param_info->name);
-  g_slice_free (ParameterInfo, param_info);
+  while (n > 0)
+    {
+      gsize n_to_append = MIN (n, run_length);
+
+      g_string_append_len (output, run, n_to_append);
+      n -= n_to_append;
+    }
 }
 
 static void
-write_to_output_stream (GOutputStream *output_stream,
-                        const gchar   *str)
+append_spaces (GString *output,
+               gsize    n)
 {
-  gsize bytes_written;
-  GError *error = NULL;
+  append_run (output, spaces_run, sizeof (spaces_run) - 1, n);
+}
 
-  g_output_stream_write_all (output_stream,
-                             str,
-                             strlen (str),
-                             &bytes_written,
-                             NULL,
-                             &error);
-  g_assert_no_error (error);
+static void
+append_tabs (GString *output,
+             gsize    n)
+{
+  append_run (output, tabs_run, sizeof (tabs_run) - 1, n);
+}
+
+static void
+append_stars (GString *output,
+              gsize    n)
+{
+  append_run (output, stars_run, sizeof (stars_run) - 1, n);
+}
+
+/* Returns the length of the line starting at @pos, without the newline. */
+static gsize
+get_line_length (Parser *parser,
+                 gsize   pos)
+{
+  const gchar *newline;
+
+  newline = memchr (parser->contents + pos, '\n', parser->length - pos);
+
+  if (newline == NULL)
+    return parser->length - pos;
+
+  return newline - (parser->contents + pos);
 }
 
+/* Returns whether there is a line after the line at @pos of length
+ * @line_length. Sets @next_line_pos to its start. The next line can be empty
+ * and end the contents.
+ */
 static gboolean
-match_function_name (const gchar  *line,
-                     gchar       **function_name,
-                     gint         *first_param_pos)
+get_next_line_pos (Parser *parser,
+                   gsize   pos,
+                   gsize   line_length,
+                   gsize  *next_line_pos)
 {
-  static GRegex *regex = NULL;
-  GMatchInfo *match_info;
-  gint end_pos;
-  gboolean match = FALSE;
+  if (pos + line_length == parser->length)
+    return FALSE;
 
-  if (G_UNLIKELY (regex == NULL))
-    regex = g_regex_new ("^(\\w+) ?\\(", G_REGEX_OPTIMIZE, 0, NULL);
+  *next_line_pos = pos + line_length + 1;
+  return TRUE;
+}
 
-  g_regex_match (regex, line, 0, &match_info);
+static gboolean
+is_identifier_char (gchar c)
+{
+  return g_ascii_isalnum (c) || c == '_';
+}
 
-  if (g_match_info_matches (match_info) &&
-      g_match_info_fetch_pos (match_info, 1, NULL, &end_pos) &&
-      g_match_info_fetch_pos (match_info, 0, NULL, first_param_pos))
-    {
-      match = TRUE;
+static gsize
+skip_spaces (const gchar *line,
+             gsize        length,
+             gsize        pos)
+{
+  while (pos < length && g_ascii_isspace (line[pos]))
+    pos++;
 
-      if (function_name != NULL)
-        *function_name = g_strndup (line, end_pos);
-    }
+  return pos;
+}
+
+static gsize
+skip_identifier (const gchar *line,
+                 gsize        length,
+                 gsize        pos)
+{
+  while (pos < length && is_identifier_char (line[pos]))
+    pos++;
 
-  g_match_info_free (match_info);
-  return match;
+  return pos;
 }
 
+/* "struct", "struct _Name", "typedef struct" or "typedef struct _Name". */
 static gboolean
-match_parameter (gchar          *line,
-                 ParameterInfo **info,
-                 gboolean       *is_last_parameter)
+is_struct_header_line (const gchar *line,
+                       gsize        length)
 {
-  static GRegex *regex = NULL;
-  GMatchInfo *match_info;
-  gint start_pos = 0;
+  gsize pos = 0;
 
-  if (G_UNLIKELY (regex == NULL))
-    regex = g_regex_new ("^\\s*(?<type>(const\\s+)?\\w+)\\s+(?<stars>\\**)\\s*(?<name>\\w+)\\s*(?<end>,|\\))\\s*$",
-                         G_REGEX_OPTIMIZE,
-                         0,
-                         NULL);
+  if (length > 7 &&
+      strncmp (line, "typedef", 7) == 0 &&
+      g_ascii_isspace (line[7]))
+    pos = skip_spaces (line, length, 7);
 
-  if (is_last_parameter != NULL)
-    *is_last_parameter = FALSE;
+  if (length - pos < 6 ||
+      strncmp (line + pos, "struct", 6) != 0)
+    return FALSE;
 
-  match_function_name (line, NULL, &start_pos);
+  pos += 6;
 
-  g_regex_match (regex, line + start_pos, 0, &match_info);
+  if (pos < length && is_identifier_char (line[pos]))
+    return FALSE;
 
-  if (!g_match_info_matches (match_info))
-    {
-      g_match_info_free (match_info);
-      return FALSE;
-    }
+  pos = skip_spaces (line, length, pos);
+  pos = skip_identifier (line, length, pos);
+  pos = skip_spaces (line, length, pos);
 
-  if (info != NULL)
+  return pos == length;
+}
+
+/* "};" or "} Name;". */
+static gboolean
+is_struct_end_line (const gchar *line,
+                    gsize        length)
+{
+  gsize pos;
+
+  if (length == 0 || line[0] != '}')
+    return FALSE;
+
+  pos = skip_spaces (line, length, 1);
+  pos = skip_identifier (line, length, pos);
+  pos = skip_spaces (line, length, pos);
+
+  if (pos == length || line[pos] != ';')
+    return FALSE;
+
+  pos = skip_spaces (line, length, pos + 1);
+  return pos == length;
+}
+
+/* An empty line, or a comment on one line. */
+static gboolean
+is_blank_or_comment_line (const gchar *line,
+                          gsize        length)
+{
+  gsize pos = skip_spaces (line, length, 0);
+
+  if (pos == length)
+    return TRUE;
+
+  while (g_ascii_isspace (line[length - 1]))
+    length--;
+
+  return (length - pos >= 4 &&
+          strncmp (line + pos, "/*", 2) == 0 &&
+          strncmp (line + length - 2, "*/", 2) == 0);
+}
+
+/* Whether the parsing can begin at the line @pos with the same result as when
+ * it begins before: a line starting with "{", except the second line of a
+ * struct with --structs. A function declaration ends before such a line, and a
+ * struct doesn't contain another one.
+ */
+static gboolean
+is_resume_line (const gchar *contents,
+                gsize        length,
+                gsize        pos)
+{
+  gsize header_pos;
+
+  if (pos >= length || contents[pos] != '{')
+    return FALSE;
+
+  if (!_structs || pos == 0)
+    return TRUE;
+
+  header_pos = pos - 1;
+  while (header_pos > 0 && contents[header_pos - 1] != '\n')
+    header_pos--;
+
+  return !is_struct_header_line (contents + header_pos, pos - 1 - header_pos);
+}
+
+/* Returns the start of the next struct header line at or after @pos and
+ * before @end, which must be the start of a line or parser->length, or @end if
+ * there is none. A struct header is followed by a "{" line, searched with
+ * memchr(). So that each chunk of a file searches only its own range, the
+ * search stops at the "{" line following the last line before @end.
+ */
+static gsize
+find_next_struct (Parser *parser,
+                  gsize   pos,
+                  gsize   end)
+{
+  const gchar *contents = parser->contents;
+  gsize search_end = MIN (end + 1, parser->length);
+  gsize search_pos = pos;
+  gsize last_line_pos;
+
+  while (search_pos < search_end)
     {
-      gchar *stars;
+      const gchar *brace;
+      gsize brace_pos;
+      gsize header_pos;
+
+      brace = memchr (contents + search_pos, '{', search_end - search_pos);
+      if (brace == NULL)
+        break;
+
+      brace_pos = brace - contents;
+      search_pos = brace_pos + 1;
 
-      *info = g_slice_new0 (ParameterInfo);
+      /* The header must be a whole line after @pos. */
+      if (brace_pos <= pos || contents[brace_pos - 1] != '\n')
+        continue;
 
-      (*info)->type = g_match_info_fetch_named (match_info, "type");
-      (*info)->name = g_match_info_fetch_named (match_info, "name");
-      g_assert ((*info)->type != NULL);
-      g_assert ((*info)->name != NULL);
+      header_pos = brace_pos - 1;
+      while (header_pos > pos && contents[header_pos - 1] != '\n')
+        header_pos--;
 
-      stars = g_match_info_fetch_named (match_info, "stars");
-      (*info)->nb_stars = strlen (stars);
-      g_free (stars);
+      if (is_struct_header_line (contents + header_pos, brace_pos - 1 - header_pos))
+        return header_pos;
     }
 
-  if (is_last_parameter != NULL)
+  /* More contents will follow, and the "{" line may be in it. */
+  if (!parser->is_end && end >= parser->length && parser->length > pos)
     {
-      gchar *end = g_match_info_fetch_named (match_info, "end");
-      *is_last_parameter = g_str_equal (end, ")");
-      g_free (end);
+      last_line_pos = parser->length - 1;
+      while (last_line_pos > pos && contents[last_line_pos - 1] != '\n')
+        last_line_pos--;
+
+      if (is_struct_header_line (contents + last_line_pos, parser->length - 1 - last_line_pos))
+        return last_line_pos;
     }
 
-  g_match_info_free (match_info);
-  return TRUE;
+  return end;
 }
 
-static gboolean
-match_opening_curly_brace (const gchar *line)
+/* find_next_struct() with a cache, to not search the same struct again for
+ * each function name candidate before it.
+ */
+static gsize
+get_next_struct (Parser *parser,
+                 gsize   pos,
+                 gsize   end)
+{
+  if (end != parser->struct_search_end ||
+      pos < parser->struct_search_pos ||
+      pos > parser->next_struct_pos)
+    {
+      parser->struct_search_pos = pos;
+      parser->struct_search_end = end;
+      parser->next_struct_pos = find_next_struct (parser, pos, end);
+    }
+
+  return parser->next_struct_pos;
+}
+
+/* A function name line starts with an identifier char, and contains an
+ * opening parenthesis. The other lines are skipped quickly by searching the
+ * next opening parenthesis with memchr(), which is vectorized in the libc.
+ * With --structs, the start of a struct is also a candidate.
+ *
+ * @pos and @end must be the start of a line. Returns the start of the next
+ * line before @end that can be a function name line or a struct, or @end if
+ * there is none.
+ */
+static gsize
+find_candidate_line (Parser *parser,
+                     gsize   pos,
+                     gsize   end)
 {
-  static GRegex *regex = NULL;
+  const gchar *contents = parser->contents;
+
+  if (_structs)
+    end = get_next_struct (parser, pos, end);
+
+  while (pos < end)
+    {
+      const gchar *paren;
+      const gchar *newline;
+      gsize line_start;
+
+      paren = memchr (contents + pos, '(', end - pos);
+      if (paren == NULL)
+        break;
+
+      line_start = paren - contents;
+      while (line_start > pos && contents[line_start - 1] != '\n')
+        line_start--;
+
+      /* Non-ASCII chars are classified by the line scanner. */
+      if (g_ascii_isalnum (contents[line_start]) ||
+          contents[line_start] == '_' ||
+          (guchar) contents[line_start] >= 0x80)
+        return line_start;
+
+      newline = memchr (paren, '\n', end - (paren - contents));
+      if (newline == NULL)
+        break;
 
-  if (G_UNLIKELY (regex == NULL))
-    regex = g_regex_new ("^{\\s*$", G_REGEX_OPTIMIZE, 0, NULL);
+      pos = newline + 1 - contents;
+    }
 
-  return g_regex_match (regex, line, 0, NULL);
+  return end;
 }
 
-/* Returns the number of lines that take the function declaration.
- * Returns 0 if not a function declaration. */
-static guint
-get_function_declaration_length (gchar **lines)
+static void
+scan_line (Parser      *parser,
+           gsize        pos,
+           gsize       *line_length,
+           GcuLineInfo *info)
 {
-  guint nb_lines = 1;
-  gchar **cur_line = lines;
+  *line_length = get_line_length (parser, pos);
+  gcu_line_scanner_scan (parser->contents + pos, *line_length, info);
+}
+
+/* Scans the function declaration starting at @pos and fills
+ * parser->parameter_infos. If found, @declaration_end is set to the position
+ * of the line containing the opening curly brace, or of the line following
+ * the ");" of a prototype.
+ */
+static DeclarationResult
+scan_function_declaration (Parser *parser,
+                           gsize   pos,
+                           gsize  *declaration_end)
+{
+  g_array_set_size (parser->parameter_infos, 0);
+  parser->is_prototype = FALSE;
+  parser->is_struct = FALSE;
 
-  while (*cur_line != NULL)
+  while (TRUE)
     {
-      gboolean match_param;
-      gboolean is_last_param;
+      GcuLineInfo info;
+      gsize line_length;
+      ParameterInfo param_info;
 
-      match_param = match_parameter (*cur_line, NULL, &is_last_param);
+      scan_line (parser, pos, &line_length, &info);
 
-      if (is_last_param)
-        {
-          gchar *next_line = *(cur_line + 1);
+      if (!info.is_parameter)
+        return DECLARATION_NOT_FOUND;
 
-          if (next_line == NULL ||
-              !match_opening_curly_brace (next_line))
-            return 0;
+      param_info.type_pos = pos + info.type_pos;
+      param_info.type_length = info.type_length;
+      param_info.nb_stars = info.nb_stars;
+      param_info.name_pos = pos + info.name_pos;
+      param_info.name_length = info.name_length;
+      param_info.line_pos = pos;
+      g_array_append_val (parser->parameter_infos, param_info);
 
-          return nb_lines;
+      if (!get_next_line_pos (parser, pos, line_length, &pos))
+        return DECLARATION_NOT_FOUND;
+
+      if (info.is_prototype_end)
+        {
+          parser->is_prototype = TRUE;
+          *declaration_end = pos;
+          return DECLARATION_FOUND;
         }
 
-      if (!match_param)
-        return 0;
+      if (pos == parser->length && !parser->is_end)
+        return DECLARATION_INCOMPLETE;
 
-      nb_lines++;
-      cur_line++;
-    }
+      if (info.is_last_parameter)
+        {
+          scan_line (parser, pos, &line_length, &info);
 
-  /* Should not be reachable - but silences a compiler warning. */
-  return 0;
+          if (!info.is_opening_curly_brace)
+            return DECLARATION_NOT_FOUND;
+
+          *declaration_end = pos;
+          return DECLARATION_FOUND;
+        }
+    }
 }
 
-static GSList *
-get_list_parameter_infos (gchar **lines,
-                          guint   length)
+/* Same as scan_function_declaration(), for a struct starting at @pos. The
+ * members are put in parser->parameter_infos, and @declaration_end is set to
+ * the position of the line following the end of the struct.
+ */
+static DeclarationResult
+scan_struct_declaration (Parser *parser,
+                         gsize   pos,
+                         gsize  *declaration_end)
 {
-  GSList *list = NULL;
-  gint i;
+  GcuLineInfo info;
+  gsize line_length;
 
-  for (i = length - 1; i >= 0; i--)
+  g_array_set_size (parser->parameter_infos, 0);
+  parser->is_prototype = FALSE;
+  parser->is_struct = TRUE;
+
+  /* The header, then the "{" line. */
+  line_length = get_line_length (parser, pos);
+  if (!get_next_line_pos (parser, pos, line_length, &pos))
+    return DECLARATION_NOT_FOUND;
+
+  if (pos == parser->length && !parser->is_end)
+    return DECLARATION_INCOMPLETE;
+
+  scan_line (parser, pos, &line_length, &info);
+  if (!info.is_opening_curly_brace)
+    return DECLARATION_NOT_FOUND;
+
+  while (TRUE)
     {
-      ParameterInfo *info = NULL;
+      const gchar *line;
+      ParameterInfo member_info;
 
-      match_parameter (lines[i], &info, NULL);
-      g_assert (info != NULL);
+      if (!get_next_line_pos (parser, pos, line_length, &pos))
+        return DECLARATION_NOT_FOUND;
 
-      list = g_slist_prepend (list, info);
-    }
+      if (pos == parser->length && !parser->is_end)
+        return DECLARATION_INCOMPLETE;
+
+      line = parser->contents + pos;
+      scan_line (parser, pos, &line_length, &info);
+
+      if (is_struct_end_line (line, line_length))
+        {
+          /* Like for a prototype, the end must be followed by a newline. */
+          if (parser->parameter_infos->len == 0 ||
+              !get_next_line_pos (parser, pos, line_length, declaration_end))
+            return DECLARATION_NOT_FOUND;
+
+          return DECLARATION_FOUND;
+        }
+
+      if (is_blank_or_comment_line (line, line_length))
+        continue;
 
-  return list;
+      if (!info.is_struct_member || info.is_function_name)
+        return DECLARATION_NOT_FOUND;
+
+      member_info.type_pos = pos + info.type_pos;
+      member_info.type_length = info.type_length;
+      member_info.nb_stars = info.nb_stars;
+      member_info.name_pos = pos + info.name_pos;
+      member_info.name_length = info.name_length;
+      member_info.line_pos = pos;
+      g_array_append_val (parser->parameter_infos, member_info);
+    }
 }
 
 static void
-compute_spacing (GSList *parameter_infos,
+compute_spacing (GArray *parameter_infos,
                  guint  *max_type_length,
                  guint  *max_stars_length)
 {
-  GSList *l;
+  guint i;
   *max_type_length = 0;
   *max_stars_length = 0;
 
-  for (l = parameter_infos; l != NULL; l = l->next)
+  for (i = 0; i < parameter_infos->len; i++)
     {
-      ParameterInfo *info = l->data;
-      guint type_length = strlen (info->type);
+      ParameterInfo *info = &g_array_index (parameter_infos, ParameterInfo, i);
 
-      if (type_length > *max_type_length)
-        *max_type_length = type_length;
+      if (info->type_length > *max_type_length)
+        *max_type_length = info->type_length;
 
       if (info->nb_stars > *max_stars_length)
         *max_stars_length = info->nb_stars;
@@ -319,244 +806,1362 @@ compute_spacing (GSList *parameter_infos,
 }
 
 static void
-print_parameter (GOutputStream *output_stream,
+print_parameter (Parser        *parser,
                  ParameterInfo *info,
                  guint          max_type_length,
                  guint          max_stars_length)
 {
-  gint type_length;
-  gint nb_spaces;
-  gchar *spaces;
-  gchar *stars;
+  GString *output = parser->output;
 
-  write_to_output_stream (output_stream, info->type);
+  g_assert (info->type_length <= max_type_length);
+  g_assert (info->nb_stars <= max_stars_length);
 
-  type_length = strlen (info->type);
-  nb_spaces = max_type_length - type_length;
-  g_assert (nb_spaces >= 0);
+  g_string_append_len (output,
+                       parser->contents + info->type_pos,
+                       info->type_length);
 
-  spaces = g_strnfill (nb_spaces, ' ');
-  write_to_output_stream (output_stream, spaces);
-  write_to_output_stream (output_stream, " ");
-  g_free (spaces);
+  append_spaces (output, max_type_length - info->type_length + 1);
+  append_spaces (output, max_stars_length - info->nb_stars);
+  append_stars (output, info->nb_stars);
 
-  nb_spaces = max_stars_length - info->nb_stars;
-  g_assert (nb_spaces >= 0);
-  spaces = g_strnfill (nb_spaces, ' ');
-  write_to_output_stream (output_stream, spaces);
-  g_free (spaces);
-
-  stars = g_strnfill (info->nb_stars, '*');
-  write_to_output_stream (output_stream, stars);
-  g_free (stars);
+  g_string_append_len (output,
+                       parser->contents + info->name_pos,
+                       info->name_length);
+}
 
-  write_to_output_stream (output_stream, info->name);
+static void
+print_indentation (Parser *parser,
+                   guint   nb_spaces)
+{
+  if (_tabs)
+    {
+      append_tabs (parser->output, nb_spaces / 8);
+      append_spaces (parser->output, nb_spaces % 8);
+    }
+  else
+    {
+      append_spaces (parser->output, nb_spaces);
+    }
 }
 
+/* parser->parameter_infos must have been filled by
+ * scan_function_declaration().
+ */
 static void
-print_function_declaration (GOutputStream  *output_stream,
-                            gchar         **lines,
-                            guint           length)
-{
-  gchar **cur_line = lines;
-  gchar *function_name;
-  gint nb_spaces_to_parenthesis;
-  GSList *parameter_infos;
-  GSList *l;
+print_function_declaration (Parser *parser,
+                            gsize   pos)
+{
+  GString *output = parser->output;
+  GcuLineInfo line_info;
+  gsize line_length;
+  guint nb_spaces_to_parenthesis;
   guint max_type_length;
   guint max_stars_length;
-  gchar *spaces;
+  guint i;
 
-  if (!match_function_name (*cur_line, &function_name, NULL))
+  scan_line (parser, pos, &line_length, &line_info);
+  if (!line_info.is_function_name)
     g_error ("The line doesn't match a function name.");
 
-  write_to_output_stream (output_stream, function_name);
-  write_to_output_stream (output_stream, " (");
+  g_string_append_len (output,
+                       parser->contents + pos,
+                       line_info.function_name_length);
+  g_string_append (output, " (");
 
-  nb_spaces_to_parenthesis = strlen (function_name) + 2;
+  nb_spaces_to_parenthesis = line_info.function_name_length + 2;
 
-  if (_tabs)
+  compute_spacing (parser->parameter_infos, &max_type_length, &max_stars_length);
+
+  for (i = 0; i < parser->parameter_infos->len; i++)
     {
-      gchar *tabs = g_strnfill (nb_spaces_to_parenthesis / 8, '\t');
-      gchar *spaces_after_tabs = g_strnfill (nb_spaces_to_parenthesis % 8, ' ');
+      ParameterInfo *info = &g_array_index (parser->parameter_infos, ParameterInfo, i);
 
-      spaces = g_strdup_printf ("%s%s", tabs, spaces_after_tabs);
+      if (i > 0)
+        print_indentation (parser, nb_spaces_to_parenthesis);
 
-      g_free (tabs);
-      g_free (spaces_after_tabs);
+      print_parameter (parser, info, max_type_length, max_stars_length);
+
+      if (i < parser->parameter_infos->len - 1)
+        g_string_append (output, ",\n");
     }
-  else
+
+  g_string_append (output, parser->is_prototype ? ");\n" : ")\n");
+}
+
+/* parser->parameter_infos must have been filled by
+ * scan_struct_declaration(). The lines other than the members are kept as
+ * is, and so is the indentation of the members.
+ */
+static void
+print_struct_declaration (Parser *parser,
+                          gsize   pos,
+                          gsize   declaration_end)
+{
+  GString *output = parser->output;
+  guint max_type_length;
+  guint max_stars_length;
+  guint i;
+
+  compute_spacing (parser->parameter_infos, &max_type_length, &max_stars_length);
+
+  for (i = 0; i < parser->parameter_infos->len; i++)
     {
-      spaces = g_strnfill (nb_spaces_to_parenthesis, ' ');
+      ParameterInfo *info = &g_array_index (parser->parameter_infos, ParameterInfo, i);
+
+      g_string_append_len (output, parser->contents + pos, info->type_pos - pos);
+      print_parameter (parser, info, max_type_length, max_stars_length);
+      g_string_append (output, ";\n");
+
+      /* A member is always followed by another line. */
+      pos = info->line_pos + get_line_length (parser, info->line_pos) + 1;
     }
 
-  parameter_infos = get_list_parameter_infos (lines, length);
-  compute_spacing (parameter_infos, &max_type_length, &max_stars_length);
+  g_string_append_len (output, parser->contents + pos, declaration_end - pos);
+}
 
-  for (l = parameter_infos; l != NULL; l = l->next)
-    {
-      ParameterInfo *info = l->data;
+/* After scan_function_declaration() or scan_struct_declaration(). */
+static void
+print_declaration (Parser *parser,
+                   gsize   pos,
+                   gsize   declaration_end)
+{
+  if (parser->is_struct)
+    print_struct_declaration (parser, pos, declaration_end);
+  else
+    print_function_declaration (parser, pos);
+}
 
-      if (l != parameter_infos)
-        write_to_output_stream (output_stream, spaces);
+static guint
+get_nb_threads (void)
+{
+  return _jobs > 0 ? (guint) _jobs : g_get_num_processors ();
+}
 
-      print_parameter (output_stream, info, max_type_length, max_stars_length);
+/* @contents can be NULL when the parsing is done. */
+static void
+parser_set_contents (Parser      *parser,
+                     const gchar *contents,
+                     gsize        length,
+                     gboolean     is_end)
+{
+  parser->contents = contents;
+  parser->length = length;
+  parser->is_end = is_end != FALSE;
+
+  /* Invalidate the cache of get_next_struct(). */
+  parser->struct_search_pos = G_MAXSIZE;
+  parser->struct_search_end = 0;
+  parser->next_struct_pos = 0;
+}
 
-      if (l->next != NULL)
-        write_to_output_stream (output_stream, ",\n");
-    }
+static void
+parser_init (Parser  *parser,
+             GString *output)
+{
+  parser_set_contents (parser, NULL, 0, FALSE);
+  parser->output = output;
+  parser->misaligned_declarations = NULL;
+  parser->declarations = NULL;
+  parser->is_prototype = FALSE;
+  parser->is_struct = FALSE;
+  parser->modify_start = 0;
+  parser->modify_end = G_MAXSIZE;
+  parser->parameter_infos = g_array_new (FALSE, FALSE, sizeof (ParameterInfo));
+}
+
+/* Appends the unmodified contents between @start and @end. */
+static void
+append_unmodified (Parser *parser,
+                   gsize   start,
+                   gsize   end)
+{
+  if (parser->misaligned_declarations == NULL &&
+      parser->declarations == NULL)
+    g_string_append_len (parser->output, parser->contents + start, end - start);
+}
+
+static gboolean
+is_declaration_misaligned (Parser *parser,
+                           gsize   pos,
+                           gsize   declaration_end)
+{
+  GString *output = parser->output;
 
-  write_to_output_stream (output_stream, ")\n");
+  g_string_truncate (output, 0);
+  print_declaration (parser, pos, declaration_end);
 
-  g_free (function_name);
-  g_free (spaces);
-  g_slist_free_full (parameter_infos, (GDestroyNotify)parameter_info_free);
+  return (output->len != declaration_end - pos ||
+          memcmp (output->str, parser->contents + pos, output->len) != 0);
 }
 
 static void
-parse_contents (const gchar   *input_str,
-                GOutputStream *output_stream)
+parser_clear (Parser *parser)
 {
-  gchar **lines;
-  gchar **cur_line;
+  g_array_free (parser->parameter_infos, TRUE);
+}
 
-  lines = g_strsplit (input_str, "\n", 0);
+/* Parses the lines between @start and @end, which must be the start of a
+ * line or parser->length. The result is appended to parser->output. The
+ * function declarations starting before @end can be scanned after @end.
+ *
+ * Returns the position where the parsing has stopped: @end, the end of a
+ * function declaration continuing after @end, or the start of an incomplete
+ * (or misaligned, in check mode) function declaration.
+ */
+static gsize
+parser_parse_range (Parser *parser,
+                    gsize   start,
+                    gsize   end)
+{
+  gsize pos = start;
+  gsize copy_start = start;
 
-  /* Skip the empty last line, to avoid adding an extra \n. */
-  for (cur_line = lines; cur_line[0] != NULL && cur_line[1] != NULL; cur_line++)
+  while (TRUE)
     {
-      guint length;
+      GcuLineInfo info;
+      gsize line_length;
+      DeclarationResult result;
+      gsize declaration_end = 0;
+
+      /* A declaration can end after @end. */
+      if (pos >= end)
+        break;
 
-      if (!match_function_name (*cur_line, NULL, NULL))
+      pos = find_candidate_line (parser, pos, end);
+      if (pos == end)
+        break;
+
+      scan_line (parser, pos, &line_length, &info);
+
+      if (info.is_function_name)
+        result = scan_function_declaration (parser, pos, &declaration_end);
+      else if (_structs && is_struct_header_line (parser->contents + pos, line_length))
+        result = scan_struct_declaration (parser, pos, &declaration_end);
+      else
+        result = DECLARATION_NOT_FOUND;
+
+      if (result == DECLARATION_INCOMPLETE)
+        break;
+
+      if (result == DECLARATION_FOUND &&
+          (pos >= parser->modify_end || declaration_end <= parser->modify_start))
         {
-          write_to_output_stream (output_stream, *cur_line);
-          write_to_output_stream (output_stream, "\n");
+          /* Kept as is, and its lines are not parsed again. */
+          pos = declaration_end;
           continue;
         }
 
-      length = get_function_declaration_length (cur_line);
+      if (result == DECLARATION_FOUND &&
+          parser->declarations != NULL)
+        {
+          /* Only the function declarations are listed. */
+          if (!parser->is_struct)
+            g_array_append_val (parser->declarations, pos);
+
+          pos = declaration_end;
+          continue;
+        }
 
-      if (length == 0)
+      if (result == DECLARATION_FOUND &&
+          parser->misaligned_declarations != NULL)
         {
-          write_to_output_stream (output_stream, *cur_line);
-          write_to_output_stream (output_stream, "\n");
+          if (is_declaration_misaligned (parser, pos, declaration_end))
+            {
+              g_array_append_val (parser->misaligned_declarations, pos);
+
+              if (!_check_all)
+                break;
+            }
+
+          pos = declaration_end;
           continue;
         }
 
-      print_function_declaration (output_stream, cur_line, length);
+      if (result == DECLARATION_FOUND)
+        {
+          append_unmodified (parser, copy_start, pos);
+          print_declaration (parser, pos, declaration_end);
+
+          pos = declaration_end;
+          copy_start = declaration_end;
+          continue;
+        }
 
-      cur_line += length - 1;
+      /* Skip the line with its newline, if any. */
+      pos += MIN (line_length + 1, parser->length - pos);
     }
 
-  g_strfreev (lines);
+  append_unmodified (parser, copy_start, pos);
+
+  return pos;
 }
 
-static gchar *
-get_file_contents (GFile *file)
+/* The lines are not split and copied, the contents is parsed in place. The
+ * unmodified lines between two function declarations are copied at once.
+ *
+ * If @is_end is FALSE, @contents must end with a newline, and the parsing
+ * stops before a function declaration that continues after @length.
+ *
+ * Returns the number of bytes of @contents that have been parsed, the result
+ * is appended to parser->output.
+ */
+static gsize
+parser_parse (Parser      *parser,
+              const gchar *contents,
+              gsize        length,
+              gboolean     is_end)
 {
-  gchar *path;
-  gchar *contents;
-  GError *error = NULL;
+  gsize nb_bytes_parsed;
 
-  path = g_file_get_path (file);
-  g_file_get_contents (path, &contents, NULL, &error);
+  g_assert (is_end || length == 0 || contents[length - 1] == '\n');
 
-  if (error != NULL)
-    g_error ("Impossible to get file contents: %s", error->message);
+  parser_set_contents (parser, contents, length, is_end);
+  nb_bytes_parsed = parser_parse_range (parser, 0, length);
+  parser_set_contents (parser, NULL, 0, FALSE);
 
-  g_free (path);
-  return contents;
+  return nb_bytes_parsed;
 }
 
-static gchar *
-get_stdin_contents (void)
+/* Advances @pos, the start of the line number @line_num, to the start of the
+ * line number @target_line_num, or to @length.
+ */
+static void
+advance_to_line (const gchar *contents,
+                 gsize        length,
+                 gsize       *pos,
+                 guint       *line_num,
+                 guint        target_line_num)
 {
-  GInputStream *stream;
-  GString *string;
-  GError *error = NULL;
+  while (*line_num < target_line_num && *pos < length)
+    {
+      const gchar *newline = memchr (contents + *pos, '\n', length - *pos);
 
-  stream = g_unix_input_stream_new (STDIN_FILENO, FALSE);
-  string = g_string_new ("");
+      *pos = newline != NULL ? (gsize) (newline + 1 - contents) : length;
+      (*line_num)++;
+    }
+}
 
-  while (TRUE)
+/* @line_ranges must be sorted and merged. The empty ranges (after the end of
+ * the contents) are not returned.
+ */
+static GArray *
+get_byte_ranges (const gchar *contents,
+                 gsize        length,
+                 GArray      *line_ranges)
+{
+  GArray *byte_ranges;
+  gsize pos = 0;
+  guint line_num = 1;
+  guint i;
+
+  byte_ranges = g_array_sized_new (FALSE, FALSE, sizeof (ByteRange), line_ranges->len);
+
+  for (i = 0; i < line_ranges->len; i++)
     {
-      gchar buffer[4097] = { '\0' };
-      gssize nb_bytes_read = g_input_stream_read (stream, buffer, 4096, NULL, &error);
+      LineRange *line_range = &g_array_index (line_ranges, LineRange, i);
+      ByteRange byte_range;
 
-      if (nb_bytes_read == 0)
-        break;
+      advance_to_line (contents, length, &pos, &line_num, line_range->first);
+      byte_range.start = pos;
 
-      if (error != NULL)
-        g_error ("Impossible to read stdin: %s", error->message);
+      advance_to_line (contents, length, &pos, &line_num, line_range->last + 1);
+      byte_range.end = pos;
 
-      g_string_append (string, buffer);
+      if (byte_range.start < byte_range.end)
+        g_array_append_val (byte_ranges, byte_range);
     }
 
-  g_input_stream_close (stream, NULL, NULL);
-  g_object_unref (stream);
-
-  return g_string_free (string, FALSE);
+  return byte_ranges;
 }
 
-static GOutputStream *
-get_file_output_stream (GFile *file)
+/* Returns the start of the last resume line at or before @pos, or @min_pos.
+ * @min_pos and @pos must be the start of a line.
+ */
+static gsize
+find_previous_resume_line (Parser *parser,
+                           gsize   min_pos,
+                           gsize   pos)
 {
-  GFileOutputStream *output_stream;
+  const gchar *contents = parser->contents;
+
+  while (pos > min_pos)
+    {
+      if (is_resume_line (contents, parser->length, pos))
+        return pos;
+
+      pos--;
+      while (pos > min_pos && contents[pos - 1] != '\n')
+        pos--;
+    }
+
+  return min_pos;
+}
+
+/* Like parser_parse() with @is_end, but only the function declarations
+ * overlapping @line_ranges are modified.
+ *
+ * The parsing of a range begins at the last resume line before it, so the
+ * result is the same as if all the contents was parsed. The contents between the ranges
+ * is copied without being parsed.
+ */
+static void
+parser_parse_line_ranges (Parser      *parser,
+                          const gchar *contents,
+                          gsize        length,
+                          GArray      *line_ranges)
+{
+  GArray *byte_ranges;
+  gsize pos = 0;
+  guint i;
+
+  parser_set_contents (parser, contents, length, TRUE);
+
+  byte_ranges = get_byte_ranges (contents, length, line_ranges);
+
+  for (i = 0; i < byte_ranges->len; i++)
+    {
+      ByteRange *range = &g_array_index (byte_ranges, ByteRange, i);
+      gsize start;
+
+      if (pos >= range->end)
+        continue;
+
+      start = find_previous_resume_line (parser, pos, MAX (pos, range->start));
+      append_unmodified (parser, pos, start);
+
+      parser->modify_start = range->start;
+      parser->modify_end = range->end;
+      pos = parser_parse_range (parser, start, range->end);
+
+      /* In check mode without --all, stop at the first misaligned one. */
+      if (parser->misaligned_declarations != NULL &&
+          parser->misaligned_declarations->len > 0 &&
+          !_check_all)
+        break;
+    }
+
+  append_unmodified (parser, pos, length);
+
+  g_array_free (byte_ranges, TRUE);
+  parser_set_contents (parser, NULL, 0, FALSE);
+  parser->modify_start = 0;
+  parser->modify_end = G_MAXSIZE;
+}
+
+/* @line_ranges can be NULL to modify all the function declarations. */
+static void
+parse_contents (const gchar *contents,
+                gsize        length,
+                GArray      *line_ranges,
+                GString     *output)
+{
+  Parser parser;
+
+  parser_init (&parser, output);
+
+  if (line_ranges != NULL)
+    parser_parse_line_ranges (&parser, contents, length, line_ranges);
+  else
+    parser_parse (&parser, contents, length, TRUE);
+
+  parser_clear (&parser);
+}
+
+/* Returns the start of the next resume line after @pos, or @length. */
+static gsize
+find_chunk_end (const gchar *contents,
+                gsize        length,
+                gsize        pos)
+{
+  while (pos < length)
+    {
+      const gchar *newline;
+
+      newline = memchr (contents + pos, '\n', length - pos);
+      if (newline == NULL)
+        break;
+
+      pos = newline + 1 - contents;
+      if (is_resume_line (contents, length, pos))
+        return pos;
+    }
+
+  return length;
+}
+
+static void
+parse_chunk (gpointer data,
+             gpointer user_data)
+{
+  Chunk *chunk = data;
+  Parser parser;
+
+  parser_init (&parser, chunk->output);
+
+  parser_set_contents (&parser, chunk->contents, chunk->length, TRUE);
+  parser_parse_range (&parser, chunk->start, chunk->end);
+
+  parser_clear (&parser);
+}
+
+/* For big files. The contents can be split in chunks that start with a
+ * resume line (see is_resume_line()), the chunks are parsed in parallel, and
+ * the outputs are concatenated. The result is the same as parse_contents().
+ */
+static void
+parse_contents_in_parallel (const gchar *contents,
+                            gsize        length,
+                            gsize        chunk_size,
+                            GString     *output)
+{
+  GArray *chunks;
+  GThreadPool *pool;
+  gsize pos = 0;
+  guint i;
   GError *error = NULL;
 
-  output_stream = g_file_replace (file,
-                                  NULL,
-                                  FALSE,
-                                  G_FILE_CREATE_NONE,
-                                  NULL,
-                                  &error);
+  chunks = g_array_new (FALSE, FALSE, sizeof (Chunk));
+
+  while (pos < length)
+    {
+      Chunk chunk;
+
+      chunk.contents = contents;
+      chunk.length = length;
+      chunk.start = pos;
+      chunk.end = find_chunk_end (contents, length, MIN (pos + chunk_size, length));
+      chunk.output = g_string_sized_new (chunk.end - chunk.start);
+      g_array_append_val (chunks, chunk);
+
+      pos = chunk.end;
+    }
+
+  pool = g_thread_pool_new (parse_chunk,
+                            NULL,
+                            get_nb_threads (),
+                            TRUE,
+                            &error);
   g_assert_no_error (error);
 
-  return G_OUTPUT_STREAM (output_stream);
+  for (i = 0; i < chunks->len; i++)
+    {
+      g_thread_pool_push (pool, &g_array_index (chunks, Chunk, i), &error);
+      g_assert_no_error (error);
+    }
+
+  g_thread_pool_free (pool, FALSE, TRUE);
+
+  for (i = 0; i < chunks->len; i++)
+    {
+      Chunk *chunk = &g_array_index (chunks, Chunk, i);
+
+      g_string_append_len (output, chunk->output->str, chunk->output->len);
+      g_string_free (chunk->output, TRUE);
+    }
+
+  g_array_free (chunks, TRUE);
 }
 
-static GOutputStream *
-get_stdout_output_stream (void)
+static gchar *
+get_stdin_contents (gsize *length)
 {
-  return g_unix_output_stream_new (STDOUT_FILENO, FALSE);
+  GInputStream *stream;
+  GString *string;
+  GError *error = NULL;
+
+  stream = g_unix_input_stream_new (STDIN_FILENO, FALSE);
+  string = g_string_new ("");
+
+  while (TRUE)
+    {
+      gchar buffer[4096];
+      gssize nb_bytes_read = g_input_stream_read (stream, buffer, sizeof (buffer), NULL, &error);
+
+      if (nb_bytes_read == 0)
+        break;
+
+      if (error != NULL)
+        g_error ("Impossible to read stdin: %s", error->message);
+
+      g_string_append_len (string, buffer, nb_bytes_read);
+    }
+
+  g_input_stream_close (stream, NULL, NULL);
+  g_object_unref (stream);
+
+  *length = string->len;
+  return g_string_free (string, FALSE);
 }
 
+static void
+write_output (GOutputStream *output_stream,
+              GString       *output)
+{
+  GError *error = NULL;
+
+  g_output_stream_write_all (output_stream,
+                             output->str,
+                             output->len,
+                             NULL,
+                             NULL,
+                             &error);
+  g_assert_no_error (error);
+
+  g_string_truncate (output, 0);
+}
+
+static const gchar *
+find_last_newline (const gchar *str,
+                   gsize        length)
+{
+  const gchar *p = str + length;
+
+  while (p > str)
+    {
+      p--;
+
+      if (*p == '\n')
+        return p;
+    }
+
+  return NULL;
+}
+
+/* Stdin is parsed while it is read, and the output is written as soon as
+ * possible. Only the lines that may be part of a function declaration are
+ * kept in memory, until the end of the function declaration is known.
+ */
 static void
 handle_stdin (void)
 {
-  gchar *input_str;
+  GInputStream *input_stream;
   GOutputStream *output_stream;
+  GString *pending;
+  GString *output;
+  Parser parser;
   GError *error = NULL;
 
-  input_str = get_stdin_contents ();
-  output_stream = get_stdout_output_stream ();
+  input_stream = g_unix_input_stream_new (STDIN_FILENO, FALSE);
+  output_stream = g_unix_output_stream_new (STDOUT_FILENO, FALSE);
+  pending = g_string_sized_new (STDIN_CHUNK_SIZE);
+  output = g_string_sized_new (STDIN_CHUNK_SIZE);
+  parser_init (&parser, output);
+
+  while (TRUE)
+    {
+      gchar buffer[STDIN_CHUNK_SIZE];
+      gssize nb_bytes_read;
+      const gchar *last_newline;
+      gsize nb_bytes_parsed;
+
+      nb_bytes_read = g_input_stream_read (input_stream, buffer, sizeof (buffer), NULL, &error);
+
+      if (error != NULL)
+        g_error ("Impossible to read stdin: %s", error->message);
+
+      if (nb_bytes_read == 0)
+        break;
+
+      g_string_append_len (pending, buffer, nb_bytes_read);
+
+      /* Parse only the complete lines. */
+      last_newline = find_last_newline (pending->str, pending->len);
+      if (last_newline == NULL)
+        continue;
 
-  parse_contents (input_str, output_stream);
+      nb_bytes_parsed = parser_parse (&parser,
+                                      pending->str,
+                                      last_newline + 1 - pending->str,
+                                      FALSE);
 
+      g_string_erase (pending, 0, nb_bytes_parsed);
+      write_output (output_stream, output);
+    }
+
+  parser_parse (&parser, pending->str, pending->len, TRUE);
+  write_output (output_stream, output);
+
+  g_input_stream_close (input_stream, NULL, NULL);
   g_output_stream_close (output_stream, NULL, &error);
   g_assert_no_error (error);
 
-  g_free (input_str);
+  parser_clear (&parser);
+  g_string_free (pending, TRUE);
+  g_string_free (output, TRUE);
+  g_object_unref (input_stream);
   g_object_unref (output_stream);
 }
 
+static gint
+compare_line_ranges (gconstpointer a,
+                     gconstpointer b)
+{
+  const LineRange *range_a = a;
+  const LineRange *range_b = b;
+
+  if (range_a->first != range_b->first)
+    return range_a->first < range_b->first ? -1 : 1;
+
+  if (range_a->last != range_b->last)
+    return range_a->last < range_b->last ? -1 : 1;
+
+  return 0;
+}
+
+/* Sorts the ranges and merges the overlapping or adjacent ones. */
 static void
-handle_file (GFile *file)
+sort_and_merge_line_ranges (GArray *line_ranges)
 {
-  gchar *input_str;
-  GOutputStream *output_stream;
+  guint nb_merged = 0;
+  guint i;
+
+  g_array_sort (line_ranges, compare_line_ranges);
+
+  for (i = 0; i < line_ranges->len; i++)
+    {
+      LineRange *range = &g_array_index (line_ranges, LineRange, i);
+      LineRange *merged;
+
+      if (nb_merged > 0)
+        {
+          merged = &g_array_index (line_ranges, LineRange, nb_merged - 1);
+
+          if (range->first <= (guint64) merged->last + 1)
+            {
+              merged->last = MAX (merged->last, range->last);
+              continue;
+            }
+        }
+
+      merged = &g_array_index (line_ranges, LineRange, nb_merged);
+      *merged = *range;
+      nb_merged++;
+    }
+
+  g_array_set_size (line_ranges, nb_merged);
+}
+
+/* Parses a line number at *str, and advances *str after it. */
+static gboolean
+parse_line_number (const gchar **str,
+                   guint        *line_num)
+{
+  gchar *end;
+  guint64 value;
+
+  if (!g_ascii_isdigit (**str))
+    return FALSE;
+
+  value = g_ascii_strtoull (*str, &end, 10);
+  if (value > G_MAXUINT - 1)
+    return FALSE;
+
+  *line_num = value;
+  *str = end;
+  return TRUE;
+}
+
+/* "A:B", for --lines. */
+static gboolean
+parse_line_range (const gchar *str,
+                  LineRange   *range)
+{
+  if (!parse_line_number (&str, &range->first) ||
+      *str != ':')
+    return FALSE;
+
+  str++;
+
+  if (!parse_line_number (&str, &range->last) ||
+      *str != '\0')
+    return FALSE;
+
+  return 1 <= range->first && range->first <= range->last;
+}
+
+/* "start[,count]" of a hunk header. The count is 1 by default. */
+static gboolean
+parse_hunk_range (const gchar **str,
+                  guint        *start,
+                  guint        *count)
+{
+  if (!parse_line_number (str, start))
+    return FALSE;
+
+  *count = 1;
+
+  if (**str == ',')
+    {
+      (*str)++;
+      return parse_line_number (str, count);
+    }
+
+  return TRUE;
+}
+
+static void
+add_hunk_line_range (GArray *line_ranges,
+                     guint   start,
+                     guint   count)
+{
+  LineRange range;
+
+  if (count == 0)
+    {
+      /* Only deleted lines, between the lines @start and @start + 1. A
+       * parameter may have been removed, so the function declaration
+       * around needs to be realigned.
+       */
+      range.first = MAX (start, 1);
+      range.last = start + 1;
+    }
+  else
+    {
+      range.first = start;
+      range.last = start + count - 1;
+    }
+
+  g_array_append_val (line_ranges, range);
+}
+
+/* Returns the LineRanges of a filename, or NULL if the file is skipped: a
+ * deleted file (/dev/null), or not a C file.
+ */
+static GArray *
+get_diff_line_ranges (GPtrArray   *filenames,
+                      const gchar *line,
+                      gsize        line_length)
+{
+  gchar *filename;
+  GArray *line_ranges;
+
+  /* "+++ filename[\tdate]" */
+  line += 4;
+  line_length -= 4;
+  line_length = MIN (line_length, strcspn (line, "\t\n"));
+
+  if (line_length >= 2 && strncmp (line, "b/", 2) == 0)
+    {
+      line += 2;
+      line_length -= 2;
+    }
+
+  filename = g_strndup (line, line_length);
+
+  if (g_str_equal (filename, "/dev/null") ||
+      !(g_str_has_suffix (filename, ".c") || g_str_has_suffix (filename, ".h")))
+    {
+      g_free (filename);
+      return NULL;
+    }
+
+  line_ranges = g_hash_table_lookup (_diff_line_ranges, filename);
+  if (line_ranges == NULL)
+    {
+      line_ranges = g_array_new (FALSE, FALSE, sizeof (LineRange));
+      g_hash_table_insert (_diff_line_ranges, g_strdup (filename), line_ranges);
+      g_ptr_array_add (filenames, g_strdup (filename));
+    }
+
+  g_free (filename);
+  return line_ranges;
+}
+
+/* For --diff. Reads a unified diff on stdin, fills _diff_line_ranges and adds
+ * the filenames. The lines of the hunks are counted, so that an added line
+ * starting with "++ " or "@@ " is not taken for a header.
+ */
+static gboolean
+read_diff (GPtrArray  *filenames,
+           GError    **error)
+{
+  gchar *contents;
+  gsize length;
+  gsize pos = 0;
+  GArray *line_ranges = NULL;
+  guint nb_old_lines = 0;
+  guint nb_new_lines = 0;
+  GHashTableIter iter;
+  gpointer value;
+
+  _diff_line_ranges = g_hash_table_new_full (g_str_hash,
+                                             g_str_equal,
+                                             g_free,
+                                             (GDestroyNotify) g_array_unref);
+
+  contents = get_stdin_contents (&length);
+
+  while (pos < length)
+    {
+      const gchar *line = contents + pos;
+      gsize line_length = strnlen (line, length - pos);
+      const gchar *newline = memchr (line, '\n', line_length);
+
+      if (newline != NULL)
+        line_length = newline - line;
+
+      if (nb_old_lines > 0 || nb_new_lines > 0)
+        {
+          gchar c = line_length > 0 ? line[0] : ' ';
+
+          /* An empty line is an empty context line whose space has been
+           * removed by a text editor.
+           */
+          if ((c == ' ' || c == '-') && nb_old_lines > 0)
+            nb_old_lines--;
+          if ((c == ' ' || c == '+') && nb_new_lines > 0)
+            nb_new_lines--;
+        }
+      else if (line_length >= 4 && strncmp (line, "+++ ", 4) == 0)
+        {
+          line_ranges = get_diff_line_ranges (filenames, line, line_length);
+        }
+      else if (line_length >= 4 && strncmp (line, "@@ -", 4) == 0)
+        {
+          const gchar *str = line + 4;
+          guint old_start;
+          guint new_start;
+
+          if (!parse_hunk_range (&str, &old_start, &nb_old_lines) ||
+              strncmp (str, " +", 2) != 0)
+            goto invalid;
+
+          str += 2;
+
+          if (!parse_hunk_range (&str, &new_start, &nb_new_lines))
+            goto invalid;
+
+          if (line_ranges != NULL)
+            add_hunk_line_range (line_ranges, new_start, nb_new_lines);
+        }
+
+      pos += line_length + 1;
+    }
+
+  g_hash_table_iter_init (&iter, _diff_line_ranges);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    sort_and_merge_line_ranges (value);
+
+  g_free (contents);
+  return TRUE;
+
+invalid:
+  g_set_error (error,
+               G_IO_ERROR,
+               G_IO_ERROR_INVALID_DATA,
+               "Invalid hunk header at byte %" G_GSIZE_FORMAT ".",
+               pos);
+  g_free (contents);
+  return FALSE;
+}
+
+/* Returns the LineRanges to consider for a file, or NULL to modify all the
+ * function declarations. Can be called from a worker thread.
+ */
+static GArray *
+get_line_ranges (const gchar *filename)
+{
+  if (_diff_line_ranges != NULL)
+    return g_hash_table_lookup (_diff_line_ranges, filename);
+
+  return _line_ranges;
+}
+
+/* Advances @pos, the start of the line number @line_num, to @target_pos.
+ * To count the lines incrementally when the positions are in order.
+ */
+static void
+count_lines (const gchar *contents,
+             gsize       *pos,
+             guint       *line_num,
+             gsize        target_pos)
+{
+  while (*pos < target_pos)
+    {
+      const gchar *newline = memchr (contents + *pos, '\n', target_pos - *pos);
+
+      if (newline == NULL)
+        break;
+
+      (*line_num)++;
+      *pos = newline + 1 - contents;
+    }
+}
+
+/* Prints "filename:line:function_name" for each misaligned function
+ * declaration, or "filename:line:struct _Name" for a struct.
+ */
+static void
+print_misaligned_declarations (const gchar *filename,
+                               const gchar *contents,
+                               GArray      *misaligned_declarations)
+{
+  GString *report;
+  gsize pos = 0;
+  guint line_num = 1;
+  guint i;
+
+  report = g_string_new (NULL);
+
+  for (i = 0; i < misaligned_declarations->len; i++)
+    {
+      gsize declaration_pos = g_array_index (misaligned_declarations, gsize, i);
+      gsize line_length;
+      gsize name_length;
+      GcuLineInfo info;
+
+      count_lines (contents, &pos, &line_num, declaration_pos);
+
+      line_length = strcspn (contents + declaration_pos, "\n");
+      gcu_line_scanner_scan (contents + declaration_pos, line_length, &info);
+
+      if (info.is_function_name)
+        {
+          name_length = info.function_name_length;
+        }
+      else
+        {
+          /* The struct header. */
+          name_length = line_length;
+          while (name_length > 0 && g_ascii_isspace (contents[declaration_pos + name_length - 1]))
+            name_length--;
+        }
+
+      g_string_append_printf (report, "%s:%u:%.*s\n",
+                              filename,
+                              line_num,
+                              (gint) name_length,
+                              contents + declaration_pos);
+    }
+
+  /* Printed at once, the files are checked in parallel. */
+  g_printerr ("%s", report->str);
+  g_string_free (report, TRUE);
+}
+
+/* For --check. The files are not modified. */
+static gboolean
+check_file (const gchar  *filename,
+            GError      **error)
+{
+  GFile *file;
+  gchar *contents;
+  gsize length;
+  GString *scratch;
+  GArray *line_ranges;
+  Parser parser;
+
+  file = g_file_new_for_commandline_arg (filename);
+
+  if (!g_file_load_contents (file, NULL, &contents, &length, NULL, error))
+    {
+      g_object_unref (file);
+      return FALSE;
+    }
+
+  scratch = g_string_new (NULL);
+  parser_init (&parser, scratch);
+  parser.misaligned_declarations = g_array_new (FALSE, FALSE, sizeof (gsize));
+
+  line_ranges = get_line_ranges (filename);
+  if (line_ranges != NULL)
+    parser_parse_line_ranges (&parser, contents, length, line_ranges);
+  else
+    parser_parse (&parser, contents, length, TRUE);
+
+  if (parser.misaligned_declarations->len > 0)
+    {
+      print_misaligned_declarations (filename, contents, parser.misaligned_declarations);
+      g_atomic_int_inc (&_nb_misaligned_files);
+    }
+
+  g_array_free (parser.misaligned_declarations, TRUE);
+  parser_clear (&parser);
+  g_string_free (scratch, TRUE);
+  g_free (contents);
+  g_object_unref (file);
+  return TRUE;
+}
+
+static void
+append_json_string (GString     *json,
+                    const gchar *str,
+                    gsize        length)
+{
+  gsize i;
+
+  g_string_append_c (json, '"');
+
+  for (i = 0; i < length; i++)
+    {
+      gchar c = str[i];
+
+      if (c == '"' || c == '\\')
+        {
+          g_string_append_c (json, '\\');
+          g_string_append_c (json, c);
+        }
+      else if ((guchar) c < 0x20)
+        {
+          g_string_append_printf (json, "\\u%04x", (guint) c);
+        }
+      else
+        {
+          g_string_append_c (json, c);
+        }
+    }
+
+  g_string_append_c (json, '"');
+}
+
+/* Appends the JSON object of the function declaration at @pos, on one line. */
+static void
+append_signature (Parser      *parser,
+                  const gchar *filename,
+                  guint        line_num,
+                  gsize        pos,
+                  GString     *json)
+{
+  GcuLineInfo line_info;
+  gsize line_length;
+  gsize declaration_end;
+  guint i;
+
+  scan_line (parser, pos, &line_length, &line_info);
+
+  if (scan_function_declaration (parser, pos, &declaration_end) != DECLARATION_FOUND)
+    g_error ("The function declaration can not be scanned again.");
+
+  g_string_append (json, "{\"file\":");
+  append_json_string (json, filename, strlen (filename));
+
+  g_string_append_printf (json, ",\"line\":%u,\"function\":", line_num);
+  append_json_string (json, parser->contents + pos, line_info.function_name_length);
+
+  g_string_append_printf (json, ",\"prototype\":%s,\"parameters\":[",
+                          parser->is_prototype ? "true" : "false");
+
+  for (i = 0; i < parser->parameter_infos->len; i++)
+    {
+      ParameterInfo *info = &g_array_index (parser->parameter_infos, ParameterInfo, i);
+
+      if (i > 0)
+        g_string_append_c (json, ',');
+
+      g_string_append (json, "{\"type\":");
+      append_json_string (json, parser->contents + info->type_pos, info->type_length);
+      g_string_append_printf (json, ",\"stars\":%u,\"name\":", info->nb_stars);
+      append_json_string (json, parser->contents + info->name_pos, info->name_length);
+      g_string_append_c (json, '}');
+    }
+
+  g_string_append (json, "]}\n");
+}
+
+/* For --dump-signatures. The files are not modified. */
+static gboolean
+dump_file_signatures (const gchar  *filename,
+                      GError      **error)
+{
+  GFile *file;
+  gchar *contents;
+  gsize length;
+  GArray *line_ranges;
+  GString *json;
+  Parser parser;
+  gsize pos = 0;
+  guint line_num = 1;
+  guint i;
+
+  file = g_file_new_for_commandline_arg (filename);
+
+  if (!g_file_load_contents (file, NULL, &contents, &length, NULL, error))
+    {
+      g_object_unref (file);
+      return FALSE;
+    }
+
+  parser_init (&parser, NULL);
+  parser.declarations = g_array_new (FALSE, FALSE, sizeof (gsize));
+
+  line_ranges = get_line_ranges (filename);
+  if (line_ranges != NULL)
+    parser_parse_line_ranges (&parser, contents, length, line_ranges);
+  else
+    parser_parse (&parser, contents, length, TRUE);
+
+  /* Scan the function declarations again, to get their parameters. */
+  parser_set_contents (&parser, contents, length, TRUE);
+
+  json = g_string_new (NULL);
+
+  for (i = 0; i < parser.declarations->len; i++)
+    {
+      gsize declaration_pos = g_array_index (parser.declarations, gsize, i);
+
+      count_lines (contents, &pos, &line_num, declaration_pos);
+      append_signature (&parser, filename, line_num, declaration_pos, json);
+    }
+
+  /* Printed at once, the files are processed in parallel. */
+  g_print ("%s", json->str);
+
+  g_string_free (json, TRUE);
+  g_array_free (parser.declarations, TRUE);
+  parser_clear (&parser);
+  g_free (contents);
+  g_object_unref (file);
+  return TRUE;
+}
+
+static gboolean
+handle_file (const gchar  *filename,
+             GError      **error)
+{
+  GFile *file;
+  gchar *input_str = NULL;
+  gsize input_length;
+  GString *output = NULL;
+  GArray *line_ranges;
+  gboolean ok = FALSE;
+
+  file = g_file_new_for_commandline_arg (filename);
+
+  if (!g_file_load_contents (file, NULL, &input_str, &input_length, NULL, error))
+    goto out;
+
+  output = g_string_sized_new (input_length);
+  line_ranges = get_line_ranges (filename);
+
+  if (line_ranges == NULL &&
+      !_files_in_parallel &&
+      _chunk_size > 0 &&
+      input_length > (gsize) _chunk_size * 1024 * 1024)
+    parse_contents_in_parallel (input_str, input_length, (gsize) _chunk_size * 1024 * 1024, output);
+  else
+    parse_contents (input_str, input_length, line_ranges, output);
+
+  if (output->len == input_length &&
+      memcmp (output->str, input_str, input_length) == 0)
+    {
+      g_atomic_int_inc (&_nb_unmodified_files);
+      ok = TRUE;
+      goto out;
+    }
+
+  ok = g_file_replace_contents (file,
+                                output->str,
+                                output->len,
+                                NULL,
+                                FALSE,
+                                G_FILE_CREATE_NONE,
+                                NULL,
+                                NULL,
+                                error);
+
+  if (ok)
+    g_atomic_int_inc (&_nb_modified_files);
+
+out:
+  g_object_unref (file);
+  g_free (input_str);
+  if (output != NULL)
+    g_string_free (output, TRUE);
+  return ok;
+}
+
+/* Can be called from a worker thread. */
+static void
+handle_file_and_report_error (gpointer data,
+                              gpointer user_data)
+{
+  const gchar *filename = data;
+  gboolean ok;
+  GError *error = NULL;
+
+  if (_check)
+    ok = check_file (filename, &error);
+  else if (_dump_signatures)
+    ok = dump_file_signatures (filename, &error);
+  else
+    ok = handle_file (filename, &error);
+
+  if (!ok)
+    {
+      g_printerr ("%s: %s\n", filename, error->message);
+      g_error_free (error);
+      g_atomic_int_inc (&_nb_errors);
+    }
+}
+
+static void
+handle_files (GPtrArray *filenames)
+{
+  GThreadPool *pool;
+  guint nb_threads;
+  guint i;
   GError *error = NULL;
 
-  input_str = get_file_contents (file);
-  output_stream = get_file_output_stream (file);
+  nb_threads = MIN (get_nb_threads (), filenames->len);
 
-  parse_contents (input_str, output_stream);
+  if (nb_threads <= 1)
+    {
+      for (i = 0; i < filenames->len; i++)
+        handle_file_and_report_error (g_ptr_array_index (filenames, i), NULL);
 
-  g_output_stream_close (output_stream, NULL, &error);
+      return;
+    }
+
+  _files_in_parallel = TRUE;
+
+  pool = g_thread_pool_new (handle_file_and_report_error,
+                            NULL,
+                            nb_threads,
+                            TRUE,
+                            &error);
   g_assert_no_error (error);
 
-  g_free (input_str);
-  g_object_unref (output_stream);
+  for (i = 0; i < filenames->len; i++)
+    {
+      g_thread_pool_push (pool, g_ptr_array_index (filenames, i), &error);
+      g_assert_no_error (error);
+    }
+
+  /* Wait for all the files to be processed. */
+  g_thread_pool_free (pool, FALSE, TRUE);
+}
+
+/* Adds the NUL-separated filenames contained in _files_from. */
+static gboolean
+add_filenames_from_file (GPtrArray  *filenames,
+                         GError    **error)
+{
+  gchar *contents;
+  gsize length;
+  gsize pos = 0;
+
+  if (g_str_equal (_files_from, "-"))
+    {
+      contents = get_stdin_contents (&length);
+    }
+  else if (!g_file_get_contents (_files_from, &contents, &length, error))
+    {
+      return FALSE;
+    }
+
+  while (pos < length)
+    {
+      const gchar *filename = contents + pos;
+      gsize filename_length = strnlen (filename, length - pos);
+
+      if (filename_length > 0)
+        g_ptr_array_add (filenames, g_strndup (filename, filename_length));
+
+      pos += filename_length + 1;
+    }
+
+  g_free (contents);
+  return TRUE;
 }
 
 int
@@ -564,12 +2169,15 @@ main (int    argc,
       char **argv)
 {
   GOptionContext *option_context;
+  GPtrArray *filenames;
   GError *error = NULL;
-  GFile *file;
+  gint i;
   int ret = EXIT_SUCCESS;
 
   setlocale (LC_ALL, "");
 
+  filenames = g_ptr_array_new_with_free_func (g_free);
+
   option_context = g_option_context_new ("- lineup parameters");
   g_option_context_add_main_entries (option_context, option_entries, NULL);
   if (!g_option_context_parse (option_context, &argc, &argv, &error))
@@ -580,27 +2188,107 @@ main (int    argc,
       goto exit;
     }
 
-  if (argc > 2)
+  if (_jobs < 0 || _chunk_size < 0)
     {
-      g_printerr ("Too many arguments.\n");
+      g_printerr ("The number of jobs and the chunk size can not be negative.\n");
       print_usage (argv);
       ret = EXIT_FAILURE;
       goto exit;
     }
 
-  if (argc == 1)
+  for (i = 1; i < argc; i++)
+    g_ptr_array_add (filenames, g_strdup (argv[i]));
+
+  if (_lines != NULL)
     {
+      _line_ranges = g_array_new (FALSE, FALSE, sizeof (LineRange));
+
+      for (i = 0; _lines[i] != NULL; i++)
+        {
+          LineRange range;
+
+          if (!parse_line_range (_lines[i], &range))
+            {
+              g_printerr ("Invalid line range: \"%s\".\n", _lines[i]);
+              print_usage (argv);
+              ret = EXIT_FAILURE;
+              goto exit;
+            }
+
+          g_array_append_val (_line_ranges, range);
+        }
+
+      sort_and_merge_line_ranges (_line_ranges);
+    }
+
+  if (_check && _dump_signatures)
+    {
+      g_printerr ("--check and --dump-signatures can not be used together.\n");
+      print_usage (argv);
+      ret = EXIT_FAILURE;
+      goto exit;
+    }
+
+  if (_diff &&
+      (filenames->len > 0 || _files_from != NULL || _lines != NULL))
+    {
+      g_printerr ("--diff can not be used with files, --files-from or --lines.\n");
+      print_usage (argv);
+      ret = EXIT_FAILURE;
+      goto exit;
+    }
+
+  if (_diff &&
+      !read_diff (filenames, &error))
+    {
+      g_printerr ("Impossible to read the diff: %s\n", error->message);
+      ret = EXIT_FAILURE;
+      goto exit;
+    }
+
+  if (_files_from != NULL &&
+      !add_filenames_from_file (filenames, &error))
+    {
+      g_printerr ("Impossible to read the list of files: %s\n", error->message);
+      ret = EXIT_FAILURE;
+      goto exit;
+    }
+
+  if (filenames->len == 0 && _files_from == NULL && !_diff)
+    {
+      if (_check || _dump_signatures || _lines != NULL)
+        {
+          g_printerr ("--check, --dump-signatures and --lines need files.\n");
+          print_usage (argv);
+          ret = EXIT_FAILURE;
+          goto exit;
+        }
+
       handle_stdin ();
     }
   else
     {
-      file = g_file_new_for_commandline_arg (argv[1]);
-      handle_file (file);
-      g_object_unref (file);
+      handle_files (filenames);
+
+      if (!_check && !_dump_signatures)
+        {
+          g_printerr ("Modified files: %d\n", _nb_modified_files);
+          g_printerr ("Unmodified files: %d\n", _nb_unmodified_files);
+        }
+
+      if (_nb_errors > 0 || _nb_misaligned_files > 0)
+        ret = EXIT_FAILURE;
     }
 
 exit:
   g_option_context_free (option_context);
+  g_ptr_array_unref (filenames);
+  g_free (_files_from);
+  g_strfreev (_lines);
+  if (_line_ranges != NULL)
+    g_array_free (_line_ranges, TRUE);
+  if (_diff_line_ranges != NULL)
+    g_hash_table_unref (_diff_line_ranges);
   g_clear_error (&error);
   return ret;
 }
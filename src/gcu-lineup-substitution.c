@@ -21,7 +21,8 @@
  * Do a substitution and at the same time keep a good alignment of parameters on
  * the parenthesis.
  *
- * Usage: gcu-lineup-substitution <search-text> <replacement> <file>
+ * Usage: gcu-lineup-substitution [OPTION...] <search-text> <replacement> <file>
+ *    or: gcu-lineup-substitution [OPTION...] --rules <rules-file> <file>
  * WARNING: the script directly modifies the file without doing a backup first!
  *
  * Example:
@@ -38,13 +39,18 @@
  *
  * The file is opened, all occurrences of <search-text> are replaced by
  * <replacement> while still keeping a good alignment on the following lines.
- * Then the file is saved. Make sure you have a copy of <file> before running
- * the script. The best is to have it in a version control system like Git to
- * see the diff afterwards.
+ * Then the file is saved, if it has changed. Make sure you have a copy of
+ * <file> before running the script. The best is to have it in a version
+ * control system like Git to see the diff afterwards.
  *
- * The search is case sensitive, regular expressions are *not* supported, and it
- * does *not* try to match only at word boundaries (although it would be easy to
- * add such an option).
+ * Before loading the file, its raw bytes are mapped in memory and the search
+ * texts are searched in them. If none is found, the script exits without
+ * loading the file. In a tree-wide rename most files are in that case.
+ *
+ * The search is case sensitive, and regular expressions are *not* supported. By
+ * default it does *not* try to match only at word boundaries: renaming foo_bar
+ * also renames foo_bar_baz. With --identifier, an occurrence is replaced only
+ * if it doesn't start or end in the middle of a C identifier.
  *
  * Before replacing an occurrence, the script searches if (1) an opening
  * parenthesis is present further on the same line and (2) the following lines
@@ -53,7 +59,22 @@
  *
  * The script works with both tabs and spaces. It just sees what is used before
  * adjusting the alignment, and inserts tabs and/or spaces accordingly. Run the
- * script on tests/gcu-lineup-substitution/sample.c to see the result.
+ * script on tests/gcu-lineup-substitution/sample.c to see the result. The tab
+ * width is 8 by default, it can be changed with --tab-width.
+ *
+ * With --rules, several substitutions are done in one pass, the file is loaded
+ * and saved only once. The rules file contains one substitution per line, the
+ * search text and the replacement separated by a tab:
+ *
+ * old_function<TAB>new_function
+ * OldType<TAB>NewType
+ *
+ * Empty lines and lines starting with '#' are ignored. All the search texts are
+ * searched at the same time, with the Aho-Corasick algorithm. When several
+ * search texts match at the same position the longest one wins, and a
+ * replacement is never searched again. So the result is the same as running
+ * the script once per rule, except when a replacement contains another search
+ * text, or when search texts overlap.
  *
  * The script doesn't fix broken alignment. It assumes that the code is
  * initially well indented. Fixing broken alignment is a harder problem to
@@ -63,58 +84,140 @@
  * https://mail.gnome.org/archives/desktop-devel-list/2015-September/msg00020.html
  */
 
-/* Note: yes, this script uses GTK+ and GtkSourceView, because
- * GtkSourceBuffer/GtkTextBuffer are good at navigating through text and editing
- * it. Another reason is because I'm familiar with those APIs, so it was easier
- * for me to write the code. And in the future, this code might be useful for a
- * graphical text editor based on GtkSourceView.
+/* Note: the file is loaded and saved with Tepl, which detects the character
+ * encoding and keeps it when saving. The substitution itself works on the
+ * UTF-8 text of the whole buffer: the matches and the adjusted indentations are
+ * first collected as a list of edits (a byte range plus the new text), without
+ * modifying anything, and the new text is then built in one linear copy. So
+ * the time and memory don't depend on the number of edits times the cost of a
+ * GtkTextBuffer modification.
+ *
+ * No widget is created, so gtk_init() is not needed and the script can run
+ * without a display. The visual columns are computed by gcu-visual-column.c.
  */
 #include <tepl/tepl.h>
 #include <stdlib.h>
 #include <locale.h>
+#include <string.h>
+#include "gcu-aho-corasick.h"
+#include "gcu-visual-column.h"
 
-typedef struct _Sub Sub;
-struct _Sub
+#define DEFAULT_TAB_WIDTH (8)
+
+typedef struct
 {
   gchar *search_text;
   gchar *replacement;
 
-  TeplBuffer *buffer;
+  /* In characters, for the alignment. */
+  glong search_text_length;
+  glong replacement_length;
+} Rule;
+
+/* Replaces the bytes [@start, @end) of the text. */
+typedef struct
+{
+  gsize start;
+  gsize end;
 
-  /* Used to call gtk_source_view_get_visual_column(), so tabs are supported for
-   * free.
+  /* The new text, or NULL for a new indentation of @n_tabs tabs followed by
+   * @n_spaces spaces.
    */
-  GtkSourceView *view;
+  const gchar *text;
+  guint n_tabs;
+  guint n_spaces;
+} Edit;
+
+/* The new indentation of a line, the key is the start of the line. */
+typedef struct
+{
+  gsize text_start;
+  guint n_tabs;
+  guint n_spaces;
+} Indentation;
+
+/* A line of the text. The positions are byte offsets. */
+typedef struct
+{
+  gsize start;
+
+  /* Without the newline characters. */
+  gsize end;
+
+  /* The start of the next line, or the end of the text. */
+  gsize next_start;
+
+  /* The first non-space character, or @end. */
+  gsize text_start;
+} Line;
+
+typedef struct _Sub Sub;
+struct _Sub
+{
+  /* The index of a rule is the id of its search text in @automaton. */
+  GPtrArray *rules;
+  GcuAhoCorasick *automaton;
+  GcuAhoCorasickFlags search_flags;
+
+  GFile *location;
+  TeplBuffer *buffer;
+
+  guint tab_width;
+
+  /* Whether a search text contains a non-ASCII character. */
+  guint has_non_ascii_search_text : 1;
+
+  /* During the substitution: the initial text, and the new indentations. */
+  const gchar *text;
+  gsize text_length;
+  GHashTable *indentations;
+};
+
+static gint _tab_width = DEFAULT_TAB_WIDTH;
+static gchar *_rules_filename = NULL;
+static gboolean _identifier = FALSE;
+
+static GMainLoop *main_loop;
+
+static GOptionEntry option_entries[] =
+{
+  { "tab-width", 0, 0, G_OPTION_ARG_INT, &_tab_width,
+    "Width of a tab, in columns (default: 8).", "N" },
+  { "rules", 0, 0, G_OPTION_ARG_FILENAME, &_rules_filename,
+    "Do the substitutions listed in FILE, one per line.", "FILE" },
+  { "identifier", 0, 0, G_OPTION_ARG_NONE, &_identifier,
+    "Replace only whole C identifiers.", NULL },
+  { NULL }
 };
 
+static void
+rule_free (gpointer data)
+{
+  Rule *rule = data;
+
+  if (rule != NULL)
+    {
+      g_free (rule->search_text);
+      g_free (rule->replacement);
+      g_free (rule);
+    }
+}
+
+/* The buffer is created only when the file is loaded, by sub_launch(). */
 static Sub *
-sub_new (const gchar *search_text,
-         const gchar *replacement,
-         const gchar *filename)
+sub_new (const gchar *filename,
+         guint        tab_width)
 {
   Sub *sub = g_new0 (Sub, 1);
-  GFile *location;
-  TeplFile *file;
 
-  g_assert (search_text != NULL);
-  g_assert (search_text[0] != '\0');
-  g_assert (replacement != NULL);
   g_assert (filename != NULL);
   g_assert (filename[0] != '\0');
+  g_assert (tab_width > 0);
 
-  sub->search_text = g_strdup (search_text);
-  sub->replacement = g_strdup (replacement);
-
-  sub->buffer = tepl_buffer_new ();
-  gtk_source_buffer_set_implicit_trailing_newline (GTK_SOURCE_BUFFER (sub->buffer), FALSE);
-
-  location = g_file_new_for_commandline_arg (filename);
-  file = tepl_buffer_get_file (sub->buffer);
-  tepl_file_set_location (file, location);
-  g_object_unref (location);
-
-  sub->view = GTK_SOURCE_VIEW (gtk_source_view_new_with_buffer (GTK_SOURCE_BUFFER (sub->buffer)));
-  g_object_ref_sink (sub->view);
+  sub->rules = g_ptr_array_new_with_free_func (rule_free);
+  sub->automaton = gcu_aho_corasick_new ();
+  sub->location = g_file_new_for_commandline_arg (filename);
+  sub->tab_width = tab_width;
 
   return sub;
 }
@@ -124,15 +227,185 @@ sub_free (Sub *sub)
 {
   if (sub != NULL)
     {
-      g_free (sub->search_text);
-      g_free (sub->replacement);
+      g_ptr_array_unref (sub->rules);
+      gcu_aho_corasick_free (sub->automaton);
+      g_clear_object (&sub->location);
       g_clear_object (&sub->buffer);
-      g_clear_object (&sub->view);
 
       g_free (sub);
     }
 }
 
+/* Returns FALSE if there is already a rule with the same search text. */
+static gboolean
+sub_add_rule (Sub         *sub,
+              const gchar *search_text,
+              const gchar *replacement)
+{
+  Rule *rule;
+  const gchar *p;
+  guint id;
+
+  g_assert (search_text != NULL);
+  g_assert (search_text[0] != '\0');
+  g_assert (replacement != NULL);
+
+  id = gcu_aho_corasick_add_pattern (sub->automaton, search_text, strlen (search_text));
+  if (id != sub->rules->len)
+    return FALSE;
+
+  rule = g_new0 (Rule, 1);
+  rule->search_text = g_strdup (search_text);
+  rule->replacement = g_strdup (replacement);
+  rule->search_text_length = g_utf8_strlen (search_text, -1);
+  rule->replacement_length = g_utf8_strlen (replacement, -1);
+
+  g_ptr_array_add (sub->rules, rule);
+
+  for (p = search_text; *p != '\0'; p++)
+    {
+      if ((guchar) *p >= 0x80)
+        sub->has_non_ascii_search_text = TRUE;
+    }
+
+  return TRUE;
+}
+
+/* The errors are reported as "file:line: message" when they concern a line. */
+static gboolean
+sub_add_rules_from_file (Sub          *sub,
+                         const gchar  *rules_filename,
+                         GError      **error)
+{
+  gchar *contents;
+  gsize length;
+  gchar **lines = NULL;
+  gboolean ok = FALSE;
+  gint i;
+
+  if (!g_file_get_contents (rules_filename, &contents, &length, error))
+    return FALSE;
+
+  if (!g_utf8_validate (contents, length, NULL))
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVALID_DATA,
+                   "%s: the rules file is not valid UTF-8.",
+                   rules_filename);
+      goto out;
+    }
+
+  lines = g_strsplit (contents, "\n", -1);
+
+  for (i = 0; lines[i] != NULL; i++)
+    {
+      gchar *line = lines[i];
+      gsize line_length = strlen (line);
+      gchar *tab;
+
+      if (line_length > 0 && line[line_length - 1] == '\r')
+        line[line_length - 1] = '\0';
+
+      if (line[0] == '\0' || line[0] == '#')
+        continue;
+
+      tab = strchr (line, '\t');
+      if (tab == NULL)
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_INVALID_DATA,
+                       "%s:%d: the search text and the replacement must be separated by a tab.",
+                       rules_filename, i + 1);
+          goto out;
+        }
+
+      *tab = '\0';
+
+      if (line[0] == '\0')
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_INVALID_DATA,
+                       "%s:%d: the search text is empty.",
+                       rules_filename, i + 1);
+          goto out;
+        }
+
+      if (!sub_add_rule (sub, line, tab + 1))
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_INVALID_DATA,
+                       "%s:%d: there is already a rule for \"%s\".",
+                       rules_filename, i + 1, line);
+          goto out;
+        }
+    }
+
+  if (sub->rules->len == 0)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVALID_DATA,
+                   "%s: there are no rules.",
+                   rules_filename);
+      goto out;
+    }
+
+  ok = TRUE;
+
+out:
+  g_strfreev (lines);
+  g_free (contents);
+  return ok;
+}
+
+/* Returns FALSE only if the file doesn't contain any search text, without
+ * loading it in a buffer. The file is mapped in memory, and the UTF-8 search
+ * texts are searched in its raw bytes, all at once with the automaton.
+ *
+ * An ASCII search text is encoded the same way in the other encodings that
+ * the file loader can detect, except UTF-16 and UTF-32 that contain NUL bytes.
+ * A non-ASCII search text is reliably found only in a UTF-8 file. In the
+ * uncertain cases, and if the file can't be mapped, TRUE is returned and the
+ * file is loaded normally.
+ */
+static gboolean
+file_may_contain_search_texts (Sub *sub)
+{
+  gchar *path;
+  GMappedFile *mapped_file;
+  const gchar *contents;
+  gsize length;
+  gboolean may_contain = FALSE;
+
+  path = g_file_get_path (sub->location);
+  if (path == NULL)
+    return TRUE;
+
+  /* If it fails, the error is reported when loading the file. */
+  mapped_file = g_mapped_file_new (path, FALSE, NULL);
+  g_free (path);
+
+  if (mapped_file == NULL)
+    return TRUE;
+
+  contents = g_mapped_file_get_contents (mapped_file);
+  length = g_mapped_file_get_length (mapped_file);
+
+  /* An empty file has a NULL content. */
+  if (length > 0 &&
+      (memchr (contents, '\0', length) != NULL ||
+       (sub->has_non_ascii_search_text && !g_utf8_validate (contents, length, NULL)) ||
+       gcu_aho_corasick_contains_any (sub->automaton, contents, length)))
+    may_contain = TRUE;
+
+  g_mapped_file_unref (mapped_file);
+  return may_contain;
+}
+
 static void
 save_cb (GObject      *source_object,
          GAsyncResult *result,
@@ -147,7 +420,7 @@ save_cb (GObject      *source_object,
   if (error != NULL)
     g_error ("Error when saving file: %s", error->message);
 
-  gtk_main_quit ();
+  g_main_loop_quit (main_loop);
 }
 
 static void
@@ -180,189 +453,162 @@ check_parentheses_columns (GSList *list)
     }
 }
 
-/* Returns the column numbers in reverse order. */
-static GSList *
-get_parentheses_columns (Sub               *sub,
-                         const GtkTextIter *pos)
+static inline gboolean
+is_space (gchar c)
 {
-  GtkTextIter limit;
-  GtkTextIter iter;
-  GtkTextIter match_end;
-  GSList *list = NULL;
-
-  limit = *pos;
-  if (!gtk_text_iter_ends_line (&limit))
-    gtk_text_iter_forward_to_line_end (&limit);
-
-  iter = *pos;
-  while (gtk_text_iter_forward_search (&iter,
-                                       "(",
-                                       GTK_TEXT_SEARCH_TEXT_ONLY,
-                                       NULL,
-                                       &match_end,
-                                       &limit))
-    {
-      gint column;
-
-      column = gtk_source_view_get_visual_column (sub->view, &match_end);
-      list = g_slist_prepend (list, GINT_TO_POINTER (column));
-
-      iter = match_end;
-    }
-
-  check_parentheses_columns (list);
-  return list;
+  return c == ' ' || c == '\t' || c == '\v' || c == '\f';
 }
 
 static void
-forward_iter_to_text_start (GtkTextIter *iter)
+get_line (Sub   *sub,
+          gsize  line_start,
+          Line  *line)
 {
-  g_assert (gtk_text_iter_starts_line (iter));
+  const gchar *text = sub->text;
+  const gchar *newline;
+
+  line->start = line_start;
 
-  while (!gtk_text_iter_is_end (iter) &&
-         !gtk_text_iter_ends_line (iter))
+  newline = memchr (text + line_start, '\n', sub->text_length - line_start);
+  if (newline != NULL)
     {
-      gunichar cur_char;
+      line->end = newline - text;
+      line->next_start = line->end + 1;
+    }
+  else
+    {
+      line->end = sub->text_length;
+      line->next_start = sub->text_length;
+    }
 
-      cur_char = gtk_text_iter_get_char (iter);
-      if (!g_unichar_isspace (cur_char))
-        break;
+  if (line->end > line->start && text[line->end - 1] == '\r')
+    line->end--;
 
-      gtk_text_iter_forward_char (iter);
-    }
+  line->text_start = line->start;
+  while (line->text_start < line->end && is_space (text[line->text_start]))
+    line->text_start++;
 }
 
-static gint
-get_text_start_column (Sub               *sub,
-                       const GtkTextIter *start_iter)
+/* Gets the current indentation of @line, taking into account the edits
+ * already decided. @text_start_column is set to -1 if the line contains only
+ * spaces.
+ */
+static void
+get_indentation (Sub        *sub,
+                 const Line *line,
+                 gint       *text_start_column,
+                 gboolean   *contains_tab)
 {
-  GtkTextIter iter;
+  Indentation *indentation;
+  gsize indentation_length = line->text_start - line->start;
 
-  g_assert (gtk_text_iter_starts_line (start_iter));
+  indentation = g_hash_table_lookup (sub->indentations, GSIZE_TO_POINTER (line->start));
 
-  iter = *start_iter;
-  forward_iter_to_text_start (&iter);
-
-  if (gtk_text_iter_is_end (&iter) ||
-      gtk_text_iter_ends_line (&iter))
-    return -1;
+  if (indentation != NULL)
+    {
+      *text_start_column = indentation->n_tabs * sub->tab_width + indentation->n_spaces;
+      *contains_tab = indentation->n_tabs > 0;
+    }
+  else
+    {
+      *text_start_column = gcu_visual_column_advance (sub->text + line->start,
+                                                      indentation_length,
+                                                      0,
+                                                      sub->tab_width);
+      *contains_tab = memchr (sub->text + line->start, '\t', indentation_length) != NULL;
+    }
 
-  return gtk_source_view_get_visual_column (sub->view, &iter);
+  if (line->text_start == line->end)
+    *text_start_column = -1;
 }
 
-static gboolean
-indentation_contains_tab (const GtkTextIter *line_iter)
+/* Returns the column numbers in reverse order, of the characters following
+ * the opening parentheses found after @pos on @line. @column is the current
+ * visual column of @pos.
+ */
+static GSList *
+get_parentheses_columns (Sub        *sub,
+                         const Line *line,
+                         gsize       pos,
+                         guint       column)
 {
-  GtkTextIter iter;
-
-  iter = *line_iter;
-  gtk_text_iter_set_line_offset (&iter, 0);
+  const gchar *parenthesis;
+  GSList *list = NULL;
 
-  while (!gtk_text_iter_is_end (&iter) &&
-         !gtk_text_iter_ends_line (&iter))
+  while (pos < line->end &&
+         (parenthesis = memchr (sub->text + pos, '(', line->end - pos)) != NULL)
     {
-      gunichar cur_char;
+      gsize after_parenthesis = parenthesis - sub->text + 1;
 
-      cur_char = gtk_text_iter_get_char (&iter);
-      if (cur_char == '\t')
-        return TRUE;
-
-      if (!g_unichar_isspace (cur_char))
-        break;
+      column = gcu_visual_column_advance (sub->text + pos,
+                                          after_parenthesis - pos,
+                                          column,
+                                          sub->tab_width);
+      list = g_slist_prepend (list, GINT_TO_POINTER (column));
 
-      gtk_text_iter_forward_char (&iter);
+      pos = after_parenthesis;
     }
 
-  return FALSE;
+  check_parentheses_columns (list);
+  return list;
 }
 
 static void
-adjust_alignment_at_line (Sub         *sub,
-                          GtkTextIter *line_start)
+adjust_alignment_at_line (Sub        *sub,
+                          const Rule *rule,
+                          const Line *line,
+                          gint        text_start_column,
+                          gboolean    align_with_tabs)
 {
-  GtkTextIter text_start;
+  Indentation *indentation;
   gint new_length;
-  gboolean align_with_tabs;
 
-  g_assert (gtk_text_iter_starts_line (line_start));
+  g_assert (line->text_start < line->end);
 
-  text_start = *line_start;
-  forward_iter_to_text_start (&text_start);
-  g_assert (!gtk_text_iter_is_end (&text_start));
-  g_assert (!gtk_text_iter_ends_line (&text_start));
-
-  new_length = (get_text_start_column (sub, line_start) -
-                g_utf8_strlen (sub->search_text, -1) +
-                g_utf8_strlen (sub->replacement, -1));
+  new_length = (text_start_column -
+                rule->search_text_length +
+                rule->replacement_length);
   g_assert_cmpint (new_length, >=, 0);
 
-  align_with_tabs = indentation_contains_tab (line_start);
-
-  gtk_text_buffer_delete (GTK_TEXT_BUFFER (sub->buffer),
-                          line_start,
-                          &text_start);
+  indentation = g_hash_table_lookup (sub->indentations, GSIZE_TO_POINTER (line->start));
+  if (indentation == NULL)
+    {
+      indentation = g_new0 (Indentation, 1);
+      indentation->text_start = line->text_start;
+      g_hash_table_insert (sub->indentations, GSIZE_TO_POINTER (line->start), indentation);
+    }
 
   if (align_with_tabs)
     {
-      gchar *tabs;
-      gchar *spaces;
-      gchar *indentation;
-
-      tabs = g_strnfill (new_length / 8, '\t');
-      spaces = g_strnfill (new_length % 8, ' ');
-      indentation = g_strdup_printf ("%s%s", tabs, spaces);
-
-      gtk_text_buffer_insert (GTK_TEXT_BUFFER (sub->buffer),
-                              line_start,
-                              indentation,
-                              -1);
-
-      g_free (tabs);
-      g_free (spaces);
-      g_free (indentation);
+      indentation->n_tabs = new_length / sub->tab_width;
+      indentation->n_spaces = new_length % sub->tab_width;
     }
   else
     {
-      gchar *spaces;
-
-      spaces = g_strnfill (new_length, ' ');
-
-      gtk_text_buffer_insert (GTK_TEXT_BUFFER (sub->buffer),
-                              line_start,
-                              spaces,
-                              new_length);
-
-      g_free (spaces);
+      indentation->n_tabs = 0;
+      indentation->n_spaces = new_length;
     }
-
-  gtk_text_iter_set_line_offset (line_start, 0);
 }
 
-/* Takes ownership of @parentheses_columns.
- * @pos is re-validated.
- */
+/* Takes ownership of @parentheses_columns. */
 static void
-adjust_alignment_after_line (Sub         *sub,
-                             GSList      *parentheses_columns,
-                             GtkTextIter *pos)
+adjust_alignment_after_line (Sub        *sub,
+                             const Rule *rule,
+                             GSList     *parentheses_columns,
+                             gsize       next_line_start)
 {
-  GtkTextMark *mark;
-  GtkTextIter next_line;
-
-  if (parentheses_columns == NULL)
-    return;
+  gsize line_start;
 
-  mark = gtk_text_buffer_create_mark (GTK_TEXT_BUFFER (sub->buffer),
-                                      NULL,
-                                      pos,
-                                      FALSE);
-
-  next_line = *pos;
-  while (gtk_text_iter_forward_line (&next_line))
+  for (line_start = next_line_start;
+       parentheses_columns != NULL && line_start < sub->text_length;
+       )
     {
+      Line line;
       gint text_start_column;
+      gboolean contains_tab;
 
-      text_start_column = get_text_start_column (sub, &next_line);
+      get_line (sub, line_start, &line);
+      get_indentation (sub, &line, &text_start_column, &contains_tab);
 
       while (parentheses_columns != NULL)
         {
@@ -372,9 +618,12 @@ adjust_alignment_after_line (Sub         *sub,
             {
               GSList *intra_parentheses_columns;
 
-              intra_parentheses_columns = get_parentheses_columns (sub, &next_line);
+              intra_parentheses_columns = get_parentheses_columns (sub,
+                                                                   &line,
+                                                                   line.text_start,
+                                                                   text_start_column);
 
-              adjust_alignment_at_line (sub, &next_line);
+              adjust_alignment_at_line (sub, rule, &line, text_start_column, contains_tab);
 
               parentheses_columns = g_slist_concat (intra_parentheses_columns, parentheses_columns);
               check_parentheses_columns (parentheses_columns);
@@ -386,74 +635,255 @@ adjust_alignment_after_line (Sub         *sub,
           parentheses_columns = g_slist_delete_link (parentheses_columns, parentheses_columns);
         }
 
-      if (parentheses_columns == NULL)
-        break;
+      line_start = line.next_start;
     }
 
-  gtk_text_buffer_get_iter_at_mark (GTK_TEXT_BUFFER (sub->buffer),
-                                    pos,
-                                    mark);
-
-  gtk_text_buffer_delete_mark (GTK_TEXT_BUFFER (sub->buffer), mark);
-
   g_slist_free (parentheses_columns);
 }
 
 static void
-replace (Sub                    *sub,
-         GtkSourceSearchContext *search_context,
-         const GtkTextIter      *match_start,
-         GtkTextIter            *match_end)
+add_edit (GArray      *edits,
+          gsize        start,
+          gsize        end,
+          const gchar *text,
+          guint        n_tabs,
+          guint        n_spaces)
 {
-  GSList *parentheses_columns;
-  GtkTextIter start;
-  GError *error = NULL;
+  Edit edit;
 
-  parentheses_columns = get_parentheses_columns (sub, match_end);
+  edit.start = start;
+  edit.end = end;
+  edit.text = text;
+  edit.n_tabs = n_tabs;
+  edit.n_spaces = n_spaces;
 
-  start = *match_start;
-  gtk_source_search_context_replace (search_context,
-                                     &start,
-                                     match_end,
-                                     sub->replacement, -1,
-                                     &error);
+  g_array_append_val (edits, edit);
+}
 
-  if (error != NULL)
-    g_error ("Error when doing the substitution: %s", error->message);
+static gint
+compare_edits (gconstpointer a,
+               gconstpointer b)
+{
+  const Edit *edit_a = a;
+  const Edit *edit_b = b;
 
-  adjust_alignment_after_line (sub, parentheses_columns, match_end);
+  if (edit_a->start != edit_b->start)
+    return edit_a->start < edit_b->start ? -1 : 1;
+
+  /* A new indentation first. */
+  if ((edit_a->text == NULL) != (edit_b->text == NULL))
+    return edit_a->text == NULL ? -1 : 1;
+
+  return 0;
 }
 
 static void
+append_indentation (GString *string,
+                    guint    n_tabs,
+                    guint    n_spaces)
+{
+  guint i;
+
+  for (i = 0; i < n_tabs; i++)
+    g_string_append_c (string, '\t');
+
+  for (i = 0; i < n_spaces; i++)
+    g_string_append_c (string, ' ');
+}
+
+/* @edits must be sorted. An edit overlapping the next one is cut, it can
+ * happen only with a search text starting with spaces, matching in an
+ * indentation.
+ */
+static GString *
+apply_edits (const gchar *text,
+             gsize        length,
+             GArray      *edits)
+{
+  GString *new_text;
+  gsize pos = 0;
+  guint i;
+
+  new_text = g_string_sized_new (length);
+
+  for (i = 0; i < edits->len; i++)
+    {
+      const Edit *edit = &g_array_index (edits, Edit, i);
+      gsize end = edit->end;
+
+      if (i + 1 < edits->len)
+        end = MIN (end, g_array_index (edits, Edit, i + 1).start);
+
+      g_string_append_len (new_text, text + pos, edit->start - pos);
+
+      if (edit->text != NULL)
+        g_string_append (new_text, edit->text);
+      else
+        append_indentation (new_text, edit->n_tabs, edit->n_spaces);
+
+      pos = end;
+    }
+
+  g_string_append_len (new_text, text + pos, length - pos);
+  return new_text;
+}
+
+/* Returns whether the buffer has changed.
+ *
+ * The occurrences of all the search texts are found in one scan of the
+ * initial text. Then for each match, in order, the opening parentheses after
+ * it are searched on its line, and the following lines aligned on them get a
+ * new indentation. The columns are the current ones, as if the previous edits
+ * were applied: on a line, the new indentation is taken into account, and the
+ * previous matches of the line count for their replacement.
+ */
+static gboolean
 do_substitution (Sub *sub)
 {
-  GtkSourceSearchSettings *search_settings;
-  GtkSourceSearchContext *search_context;
-  GtkTextIter iter;
-  GtkTextIter match_start;
-  GtkTextIter match_end;
-
-  search_settings = gtk_source_search_settings_new ();
-  gtk_source_search_settings_set_search_text (search_settings, sub->search_text);
-  gtk_source_search_settings_set_case_sensitive (search_settings, TRUE);
-
-  search_context = gtk_source_search_context_new (GTK_SOURCE_BUFFER (sub->buffer),
-                                                  search_settings);
-
-  gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (sub->buffer), &iter);
-
-  while (gtk_source_search_context_forward (search_context,
-                                            &iter,
-                                            &match_start,
-                                            &match_end,
-                                            NULL))
+  GtkTextBuffer *buffer = GTK_TEXT_BUFFER (sub->buffer);
+  GtkTextIter start;
+  GtkTextIter end;
+  gchar *text;
+  GArray *matches;
+  GArray *edits;
+  GHashTableIter iter;
+  gpointer key;
+  gpointer value;
+  Line line = { 0, 0, 0, 0 };
+  gboolean line_is_set = FALSE;
+  gsize line_search_pos = 0;
+  gsize line_start = 0;
+  gsize column_pos = 0;
+  guint column = 0;
+  gboolean changed = FALSE;
+  guint i;
+
+  gtk_text_buffer_get_bounds (buffer, &start, &end);
+  text = gtk_text_iter_get_slice (&start, &end);
+
+  sub->text = text;
+  sub->text_length = strlen (text);
+  sub->indentations = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+
+  matches = gcu_aho_corasick_find_all (sub->automaton,
+                                       sub->text, sub->text_length,
+                                       sub->search_flags);
+
+  edits = g_array_sized_new (FALSE, FALSE, sizeof (Edit), matches->len);
+
+  for (i = 0; i < matches->len; i++)
     {
-      replace (sub, search_context, &match_start, &match_end);
-      iter = match_end;
+      const GcuAhoCorasickMatch *match = &g_array_index (matches, GcuAhoCorasickMatch, i);
+      const Rule *rule = g_ptr_array_index (sub->rules, match->pattern_id);
+      const gchar *newline;
+      GSList *parentheses_columns;
+      guint match_start_column;
+      guint match_end_column;
+
+      /* The line of the match end. */
+      while ((newline = memchr (text + line_search_pos, '\n', match->end - line_search_pos)) != NULL)
+        {
+          line_start = newline - text + 1;
+          line_search_pos = line_start;
+        }
+
+      if (!line_is_set || line.start != line_start)
+        {
+          gint text_start_column;
+          gboolean contains_tab;
+
+          get_line (sub, line_start, &line);
+          line_is_set = TRUE;
+
+          /* Start after the indentation, if it changes. */
+          get_indentation (sub, &line, &text_start_column, &contains_tab);
+          if (g_hash_table_contains (sub->indentations, GSIZE_TO_POINTER (line.start)))
+            {
+              column_pos = line.text_start;
+              column = text_start_column;
+            }
+          else
+            {
+              column_pos = line.start;
+              column = 0;
+            }
+        }
+
+      if (match->start >= column_pos)
+        {
+          match_start_column = gcu_visual_column_advance (text + column_pos,
+                                                          match->start - column_pos,
+                                                          column,
+                                                          sub->tab_width);
+          column_pos = match->start;
+        }
+      else
+        {
+          match_start_column = column;
+        }
+
+      match_end_column = gcu_visual_column_advance (text + column_pos,
+                                                    match->end - column_pos,
+                                                    match_start_column,
+                                                    sub->tab_width);
+
+      parentheses_columns = get_parentheses_columns (sub, &line, match->end, match_end_column);
+
+      add_edit (edits, match->start, match->end, rule->replacement, 0, 0);
+
+      /* The next columns on the line are after the replacement. */
+      column_pos = match->end;
+      column = gcu_visual_column_advance (rule->replacement,
+                                          strlen (rule->replacement),
+                                          match_start_column,
+                                          sub->tab_width);
+
+      adjust_alignment_after_line (sub, rule, parentheses_columns, line.next_start);
     }
 
-  g_object_unref (search_settings);
-  g_object_unref (search_context);
+  g_hash_table_iter_init (&iter, sub->indentations);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      const Indentation *indentation = value;
+
+      add_edit (edits,
+                GPOINTER_TO_SIZE (key),
+                indentation->text_start,
+                NULL,
+                indentation->n_tabs,
+                indentation->n_spaces);
+    }
+
+  if (edits->len > 0)
+    {
+      GString *new_text;
+
+      g_array_sort (edits, compare_edits);
+      new_text = apply_edits (sub->text, sub->text_length, edits);
+
+      /* A replacement can be equal to its search text. */
+      changed = (new_text->len != sub->text_length ||
+                 memcmp (new_text->str, sub->text, sub->text_length) != 0);
+
+      if (changed)
+        {
+          gtk_source_buffer_begin_not_undoable_action (GTK_SOURCE_BUFFER (buffer));
+          gtk_text_buffer_set_text (buffer, new_text->str, new_text->len);
+          gtk_source_buffer_end_not_undoable_action (GTK_SOURCE_BUFFER (buffer));
+        }
+
+      g_string_free (new_text, TRUE);
+    }
+
+  g_array_unref (edits);
+  g_array_unref (matches);
+  g_hash_table_unref (sub->indentations);
+  sub->indentations = NULL;
+  sub->text = NULL;
+  sub->text_length = 0;
+  g_free (text);
+
+  return changed;
 }
 
 static void
@@ -471,8 +901,10 @@ load_cb (GObject      *source_object,
   if (error != NULL)
     g_error ("Error when loading file: %s", error->message);
 
-  do_substitution (sub);
-  save_file (sub);
+  if (do_substitution (sub))
+    save_file (sub);
+  else
+    g_main_loop_quit (main_loop);
 }
 
 static void
@@ -481,7 +913,12 @@ sub_launch (Sub *sub)
   TeplFile *file;
   TeplFileLoader *loader;
 
+  sub->buffer = tepl_buffer_new ();
+  gtk_source_buffer_set_implicit_trailing_newline (GTK_SOURCE_BUFFER (sub->buffer), FALSE);
+
   file = tepl_buffer_get_file (sub->buffer);
+  tepl_file_set_location (file, sub->location);
+
   loader = tepl_file_loader_new (sub->buffer, file);
 
   tepl_file_loader_load_async (loader,
@@ -495,29 +932,82 @@ gint
 main (gint   argc,
       gchar *argv[])
 {
-  const gchar *search_text;
-  const gchar *replacement;
+  GOptionContext *option_context;
   const gchar *filename;
   Sub *sub;
+  GError *error = NULL;
 
   setlocale (LC_ALL, "");
 
-  gtk_init (NULL, NULL);
+  option_context = g_option_context_new ("<search-text> <replacement> <file> | --rules <rules-file> <file>");
+  g_option_context_add_main_entries (option_context, option_entries, NULL);
+  if (!g_option_context_parse (option_context, &argc, &argv, &error))
+    {
+      g_printerr ("Option parsing failed: %s\n", error->message);
+      g_printerr ("Run \"%s --help\" to see the options.\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  g_option_context_free (option_context);
 
-  if (argc != 4)
+  if (_tab_width < 1)
     {
-      g_printerr ("Usage: %s <search-text> <replacement> <file>\n", argv[0]);
+      g_printerr ("The tab width must be at least 1.\n");
+      return EXIT_FAILURE;
+    }
+
+  if ((_rules_filename == NULL && argc != 4) ||
+      (_rules_filename != NULL && argc != 2))
+    {
+      g_printerr ("Usage: %s [OPTION...] <search-text> <replacement> <file>\n", argv[0]);
+      g_printerr ("   or: %s [OPTION...] --rules <rules-file> <file>\n", argv[0]);
       g_printerr ("WARNING: the script directly modifies the file without doing a backup first!\n");
       return EXIT_FAILURE;
     }
 
-  search_text = argv[1];
-  replacement = argv[2];
-  filename = argv[3];
+  filename = argv[argc - 1];
+  if (filename[0] == '\0')
+    {
+      g_printerr ("The filename is empty.\n");
+      return EXIT_FAILURE;
+    }
+
+  if (_rules_filename == NULL && argv[1][0] == '\0')
+    {
+      g_printerr ("The search text is empty.\n");
+      return EXIT_FAILURE;
+    }
+
+  sub = sub_new (filename, _tab_width);
 
-  sub = sub_new (search_text, replacement, filename);
+  if (_identifier)
+    sub->search_flags = GCU_AHO_CORASICK_FLAGS_WHOLE_IDENTIFIERS;
+
+  if (_rules_filename != NULL)
+    {
+      if (!sub_add_rules_from_file (sub, _rules_filename, &error))
+        {
+          g_printerr ("%s\n", error->message);
+          g_error_free (error);
+          sub_free (sub);
+          return EXIT_FAILURE;
+        }
+    }
+  else
+    {
+      sub_add_rule (sub, argv[1], argv[2]);
+    }
+
+  if (!file_may_contain_search_texts (sub))
+    {
+      sub_free (sub);
+      return EXIT_SUCCESS;
+    }
+
+  main_loop = g_main_loop_new (NULL, FALSE);
   sub_launch (sub);
-  gtk_main ();
+  g_main_loop_run (main_loop);
+  g_main_loop_unref (main_loop);
+
   sub_free (sub);
 
   return EXIT_SUCCESS;
@@ -0,0 +1,63 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2017 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Visual columns on the raw bytes of a line, without a GtkSourceView.
+ *
+ * As with gtk_source_view_get_visual_column(), each character counts for one
+ * column, except a tab that goes to the next multiple of the tab width. The
+ * text is UTF-8, so only the bytes that start a character are counted.
+ *
+ * The column is advanced over a piece of a line, so a caller walking a line
+ * from left to right, or knowing the column of a position after some edits,
+ * never needs to go back to the start of the line.
+ */
+
+#include "gcu-visual-column.h"
+
+static inline gboolean
+is_utf8_continuation_byte (gchar c)
+{
+  return ((guchar) c & 0xC0) == 0x80;
+}
+
+/* Returns the visual column reached after @text, when @text starts at
+ * @column. @text must not contain a newline.
+ */
+guint
+gcu_visual_column_advance (const gchar *text,
+                           gsize        length,
+                           guint        column,
+                           guint        tab_width)
+{
+  gsize pos;
+
+  g_return_val_if_fail (text != NULL || length == 0, column);
+  g_return_val_if_fail (tab_width > 0, column);
+
+  for (pos = 0; pos < length; pos++)
+    {
+      if (text[pos] == '\t')
+        column += tab_width - (column % tab_width);
+      else if (!is_utf8_continuation_byte (text[pos]))
+        column++;
+    }
+
+  return column;
+}
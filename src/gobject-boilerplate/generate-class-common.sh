@@ -3,12 +3,10 @@
 # configuration
 
 namespace_camel=$1
-namespace_uppercase=$(gcu-case-converter --to-uppercase "$namespace_camel")
-namespace_lowercase=$(gcu-case-converter --to-lowercase "$namespace_camel")
-
 classname_camel=$2
-classname_uppercase=$(gcu-case-converter --to-uppercase "$classname_camel")
-classname_lowercase=$(gcu-case-converter --to-lowercase "$classname_camel")
+
+# Sets namespace_uppercase, namespace_lowercase, classname_uppercase, etc.
+eval "$(gcu-case-converter --all namespace="$namespace_camel" classname="$classname_camel")"
 
 filename=$3
 template_filename=$4
@@ -18,15 +16,20 @@ template_filename=$4
 cp ${template_filename}.c ${filename}.c
 cp ${template_filename}.h ${filename}.h
 
-ls ${filename}.[ch] | parallel --will-cite gcu-lineup-substitution "NAMESPACE" "$namespace_uppercase"
-ls ${filename}.[ch] | parallel --will-cite gcu-lineup-substitution "Namespace" "$namespace_camel"
-ls ${filename}.[ch] | parallel --will-cite gcu-lineup-substitution "namespace" "$namespace_lowercase"
+# All the substitutions are done in one pass per file.
+rules_file=$(mktemp)
+trap 'rm -f "$rules_file"' EXIT
 
-ls ${filename}.[ch] | parallel --will-cite gcu-lineup-substitution "CLASSNAME" "$classname_uppercase"
-ls ${filename}.[ch] | parallel --will-cite gcu-lineup-substitution "Classname" "$classname_camel"
-ls ${filename}.[ch] | parallel --will-cite gcu-lineup-substitution "classname" "$classname_lowercase"
+printf '%s\t%s\n' \
+	NAMESPACE "$namespace_uppercase" \
+	Namespace "$namespace_camel" \
+	namespace "$namespace_lowercase" \
+	CLASSNAME "$classname_uppercase" \
+	Classname "$classname_camel" \
+	classname "$classname_lowercase" \
+	filename "$filename" > "$rules_file"
 
-ls ${filename}.[ch] | parallel --will-cite gcu-lineup-substitution "filename" "$filename"
+ls ${filename}.[ch] | parallel --will-cite gcu-lineup-substitution --rules "$rules_file"
 
 gcu-lineup-parameters ${filename}.c
 
@@ -3,12 +3,10 @@
 # configuration
 
 namespace_camel=$1
-namespace_uppercase=$(gcu-case-converter --to-uppercase "$namespace_camel")
-namespace_lowercase=$(gcu-case-converter --to-lowercase "$namespace_camel")
-
 interfacename_camel=$2
-interfacename_uppercase=$(gcu-case-converter --to-uppercase "$interfacename_camel")
-interfacename_lowercase=$(gcu-case-converter --to-lowercase "$interfacename_camel")
+
+# Sets namespace_uppercase, namespace_lowercase, interfacename_uppercase, etc.
+eval "$(gcu-case-converter --all namespace="$namespace_camel" interfacename="$interfacename_camel")"
 
 filename=$3
 template_filename=$4
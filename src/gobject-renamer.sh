@@ -9,40 +9,27 @@
 filename=$1
 
 old_namespace_camel=Dh
-old_namespace_upper=$(gcu-case-converter --to-uppercase "$old_namespace_camel")
-old_namespace_lower=$(gcu-case-converter --to-lowercase "$old_namespace_camel")
-
 new_namespace_camel=Dh
-new_namespace_upper=$(gcu-case-converter --to-uppercase "$new_namespace_camel")
-new_namespace_lower=$(gcu-case-converter --to-lowercase "$new_namespace_camel")
-
 old_classname_camel=Settings
-old_classname_upper=$(gcu-case-converter --to-uppercase "$old_classname_camel")
-old_classname_lower=$(gcu-case-converter --to-lowercase "$old_classname_camel")
-
 new_classname_camel=SettingsApp
-new_classname_upper=$(gcu-case-converter --to-uppercase "$new_classname_camel")
-new_classname_lower=$(gcu-case-converter --to-lowercase "$new_classname_camel")
-
-# UPPER
-gcu-lineup-substitution "${old_namespace_upper}_${old_classname_upper}" \
-			"${new_namespace_upper}_${new_classname_upper}" \
-			"$filename"
-
-gcu-lineup-substitution "${old_namespace_upper}_IS_${old_classname_upper}" \
-			"${new_namespace_upper}_IS_${new_classname_upper}" \
-			"$filename"
-
-gcu-lineup-substitution "${old_namespace_upper}_TYPE_${old_classname_upper}" \
-			"${new_namespace_upper}_TYPE_${new_classname_upper}" \
-			"$filename"
-
-# Camel
-gcu-lineup-substitution "${old_namespace_camel}${old_classname_camel}" \
-			"${new_namespace_camel}${new_classname_camel}" \
-			"$filename"
 
-# lower
-gcu-lineup-substitution "${old_namespace_lower}_${old_classname_lower}" \
-			"${new_namespace_lower}_${new_classname_lower}" \
-			"$filename"
+# Sets old_namespace_uppercase, old_namespace_lowercase, etc.
+eval "$(gcu-case-converter --all \
+	old_namespace="$old_namespace_camel" \
+	new_namespace="$new_namespace_camel" \
+	old_classname="$old_classname_camel" \
+	new_classname="$new_classname_camel")"
+
+# All the substitutions are done in one pass.
+gcu-lineup-substitution --rules <(printf '%s\t%s\n' \
+	"${old_namespace_uppercase}_${old_classname_uppercase}" \
+	"${new_namespace_uppercase}_${new_classname_uppercase}" \
+	"${old_namespace_uppercase}_IS_${old_classname_uppercase}" \
+	"${new_namespace_uppercase}_IS_${new_classname_uppercase}" \
+	"${old_namespace_uppercase}_TYPE_${old_classname_uppercase}" \
+	"${new_namespace_uppercase}_TYPE_${new_classname_uppercase}" \
+	"${old_namespace_camel}${old_classname_camel}" \
+	"${new_namespace_camel}${new_classname_camel}" \
+	"${old_namespace_lowercase}_${old_classname_lowercase}" \
+	"${new_namespace_lowercase}_${new_classname_lowercase}") \
+	"$filename"
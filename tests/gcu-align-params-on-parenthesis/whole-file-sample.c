@@ -0,0 +1,30 @@
+static void
+function_call (gint a,
+  gint b)
+{
+  g_print ("%s (not a parenthesis\n",
+     "( /* not a comment",
+         function_call (a,
+    b), /* ( */
+    c);
+
+  /* Not aligned, no text after the parenthesis. */
+  function_call (
+    a, b);
+
+  /* Not aligned, inside curly braces. */
+  gint array[] = { a,
+     b };
+
+#define MACRO(a, \
+   b) (a + \
+  b)
+
+  if (a &&
+  (b ||
+  c))
+    return;
+
+	function_call (a,
+	  b);
+}
@@ -0,0 +1,38 @@
+/* comment */
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* With --structs */
+struct _FrobnitzClass
+{
+  GObjectClass parent_class;
+
+  /* Padding for future expansion */
+  gpointer padding[12];
+};
+
+struct _Frobnitz
+{
+  GObject parent;
+  FrobnitzPrivate *priv;
+  const gchar *name;
+};
+
+/* With tabs */
+void
+frobnitz_do_something (Frobnitz *frobnitz,
+		       const char *arg2,
+		       GError **blah);
+
+/* With spaces */
+gboolean
+frobnitz_do_something_else (Frobnitz *frobnitz,
+                            gint magic_number,
+                            GError **error);
+
+Frobnitz *
+frobnitz_new (void);
+
+G_END_DECLS